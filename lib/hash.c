@@ -30,24 +30,8 @@
     z = (z * 16777619) ^ s[i]; \
 } while( 0 )
 
-void hashw2b( Byte_t* b, Word_t w ){
-  int idx, i, s = (_H_WS * _H_WS);
-  for (i = _H_WS; i <= s; i += _H_WS) {
-    idx = (i/_H_WS) - 1;
-    b[idx] = (w >> (s - i)) & 0xff;
-  }
-}
-
-Word_t hashb2w( Byte_t* b ){
-  int idx, i, s = (_H_WS * _H_WS);
-  Word_t w = 0, n;
-  for (i = _H_WS; i <= s; i += _H_WS) {
-    idx = (i/_H_WS) - 1;
-    n = (Word_t)b[idx];
-    w |= (n << (s - i));
-  }
-  return w;
-}
+/* first slot of bucket b */
+#define hashb(h, b) (&((h)->t[(b) * _H_WAYS]))
 
 struct __ht* hashinit( void ){
   return hashalloc(_H_ALLOC);
@@ -55,24 +39,31 @@ struct __ht* hashinit( void ){
 
 struct __ht* hashalloc( int size ){
   struct __ht *h = malloc(sizeof(struct __ht));
-  int s = sizeof(struct __hn) * size;
+  int s = (size + _H_WAYS - 1) / _H_WAYS; /* buckets */
   if( !h ) return NULL;
-  h->t = malloc(s);
+  if( s < 1 ) s = 1;
+  h->t = calloc(s * _H_WAYS, sizeof(struct __hn));
   h->c = 0;
-  h->s = size;
+  h->s = s;
+  h->sc = 0;
   if( !h->t ){
     free(h);
     return NULL;
   }
-  memset(h->t, 0, s);
+  memset(h->st, 0, sizeof(h->st));
   return h;
 }
 
+void hashfree( struct __ht* h ){
+  int i;
+  for( i = 0; i < h->s * _H_WAYS; i++ ) hashnodeclear(&(h->t[i]));
+  for( i = 0; i < h->sc; i++ ) hashnodeclear(&(h->st[i]));
+  free(h->t);
+  free(h);
+}
+
 void hashnodeclear( struct __hn* n ){
-  if( n->l > (int)_H_WS ){
-    Byte_t* k = (Byte_t *)hashb2w(n->k);
-    free(k);
-  }
+  if( isoccupied(n->f) && n->l > (int)_H_WS ) free(n->k.p);
   memset(n, 0, sizeof(struct __hn));
 }
 
@@ -82,8 +73,8 @@ void hashnodeinit( struct __hn* n, Byte_t* k, int l, Word_t v, int h ){
     Byte_t* s = malloc(l);
     if( !s ) return;
     memcpy(s, k, l);
-    hashw2b(n->k, (Word_t)s);
-  } else memcpy(n->k, k, l);
+    n->k.p = s;
+  } else memcpy(n->k.b, k, l);
   n->l = l;
   n->v = v;
   n->f |= 1;
@@ -91,116 +82,153 @@ void hashnodeinit( struct __hn* n, Byte_t* k, int l, Word_t v, int h ){
 }
 
 int hashmatch( struct __hn* n, Byte_t* s, int l ){
-  Byte_t* k;
   if( !n->f || n->l != l ) return 0;
-  k = hashnodekey(n);
-  return !memcmp(k, s, l) || 0;
+  return !memcmp(hashnodekey(n), s, l);
 }
 
-void hashresize( struct __ht* h, int d ){
-  int i = 0, os; /* iterator, original table size */
-  int s = (h->s * (d ? 2 : 0.5)); /* new table size */
-  int c = h->c; /* cache old count */
-  int ms = s * sizeof(struct __hn); /* malloc size */
-  struct __hn *n, *t, *tmp;
-  Byte_t* k;
-  t = malloc(ms);
-  if( !t ) return;
-  memset(t, 0, ms);
-  os = h->s; /* store old size */
-  tmp = h->t; /* store old table */
-  h->t = t; /* set new table */
-  h->c = 0; /* erase count to avoid nested resizing */
-  h->s = s; /* set new size */
-  for( ; i < os ; i++ ){ /* for each node in old table */
-    n = &(tmp[i]); /* get node */
-    if( !n->f ) continue; /* if it's not filled, ignore */
-    if( n->l > (int)_H_WS ){
-      k = (Byte_t *)hashb2w(n->k);
-    } else k = n->k;
-    hashset(h, k, n->l, n->v); /* add node */
-  }
-  h->c = c;
-  free(tmp); /* get rid of old table */
+Byte_t* hashnodekey( struct __hn* n ){
+  if( n->l > (int)_H_WS ) return n->k.p;
+  return n->k.b;
 }
 
-Byte_t* hashnodekey( struct __hn* n ){
-  Byte_t* k;
-  if( n->l > (int)_H_WS ) k = (Byte_t *)hashb2w(n->k);
-  else k = n->k;
-  return k;
+/* bucket of key k under hash function w */
+unsigned hashbucket( struct __ht* h, Byte_t* k, int l, int w ){
+  unsigned hv;
+  if( !w ) hashfn(0, k, l, hv);
+  else     hashfn(1, k, l, hv);
+  return hv % h->s;
 }
 
-struct __hn* hashnodeclone( struct __hn* n ){
-  struct __hn* n0 = malloc(sizeof(struct __hn));
-  if( !n0 ) return NULL;
-  hashnodeinit(n0, hashnodekey(n), n->l, n->v, hashused(n->f));
-  return n0;
+/* first free slot in bucket b, or NULL */
+struct __hn* hashslot( struct __ht* h, unsigned b ){
+  struct __hn* n = hashb(h, b);
+  int i;
+  for( i = 0; i < _H_WAYS; i++ )
+    if( !isoccupied(n[i].f) ) return &n[i];
+  return NULL;
 }
 
-void hashset( struct __ht* h, Byte_t* k, int l, Word_t v ){
-  int s = h->s, f = 0;
-  unsigned hv = 0, hv0 = 0;
-  struct __hn *n, *n0, *del = NULL;
-  hashfn(0, k, l, hv0);
-  hv0 %= s;
-  hv = hashfind(h, k, l, 1);
-  n = &(h->t[hv]);
-  if( !isoccupied(n->f) ){
-    (h->c)++;
-    hashnodeinit(n, k, l, v, hv != hv0);
-    return;
+/*
+ * place a node that is not in the table yet. nodes are moved by value,
+ * so an eviction never allocates. returns 0 if both the eviction walk
+ * and the stash are exhausted; the homeless node is then left in n
+ */
+int hashplace( struct __ht* h, struct __hn* n ){
+  struct __hn tmp, *e;
+  Byte_t* k = hashnodekey(n);
+  unsigned b0 = hashbucket(h, k, n->l, 0), b1;
+  int w = 0, kicks = 0;
+  if( (e = hashslot(h, b0)) ) goto place;
+  b1 = hashbucket(h, k, n->l, 1);
+  w = 1;
+  if( (e = hashslot(h, b1)) ) goto place;
+  for( ; kicks < _H_KICKS; kicks++ ){
+    /* swap with a victim in bucket w, then try the victim's other bucket */
+    e = &(hashb(h, w ? b1 : b0)[kicks % _H_WAYS]);
+    n->f = 1 | (w << 1);
+    tmp = *e;
+    *e = *n;
+    *n = tmp;
+    w = !hashused(n->f);
+    k = hashnodekey(n);
+    if( w ) b1 = hashbucket(h, k, n->l, 1);
+    else    b0 = hashbucket(h, k, n->l, 0);
+    if( (e = hashslot(h, w ? b1 : b0)) ) goto place;
   }
-  if( hashmatch(n, k, l) ){
-    n->v = v;
-    return;
+  if( h->sc == _H_STASH ) return 0;
+  h->st[(h->sc)++] = *n;
+  return 1;
+place:
+  *e = *n;
+  e->f = 1 | (w << 1);
+  return 1;
+}
+
+void hashresize( struct __ht* h, int d ){
+  struct __hn *ot = h->t, st[_H_STASH], n;
+  int os = h->s, osc = h->sc, m = _H_ALLOC / _H_WAYS;
+  int s = d ? os * 2 : os / 2; /* new table size */
+  int i, e = os * _H_WAYS + osc; /* nodes to move */
+  if( !d && s < m ) return;
+  memcpy(st, h->st, sizeof(st));
+  for( ;; s *= 2 ){
+    h->t = calloc(s * _H_WAYS, sizeof(struct __hn));
+    if( !h->t ){ /* keep the old table */
+      h->t = ot;
+      h->s = os;
+      h->sc = osc;
+      memcpy(h->st, st, sizeof(st));
+      return;
+    }
+    h->s = s;
+    h->sc = 0;
+    for( i = 0; i < e; i++ ){
+      n = i < os * _H_WAYS ? ot[i] : st[i - os * _H_WAYS];
+      if( isoccupied(n.f) && !hashplace(h, &n) ) break;
+    }
+    if( i == e ) break;
+    free(h->t); /* didn't fit, nodes are still in ot */
   }
-  f = 0;
-  while( isoccupied(n->f) ){
-    n0 = hashnodeclone(n); /* evict */
-    hashnodeinit(n, k, l, v, !f); /* set new node */
-    f = hashused(n0->f);
-    if( del ) free(del);
-    if( !f ) hashfn(1, hashnodekey(n0), n0->l, hv);
-    else     hashfn(0, hashnodekey(n0), n0->l, hv);
-    hv %= s; /* get new slot */
-    n = &(h->t[hv]);
-    k = hashnodekey(n0);
-    l = n0->l;
-    v = n0->v;
-    del = n0;
+  free(ot);
+}
+
+void hashset( struct __ht* h, Byte_t* k, int l, Word_t v ){
+  struct __hn n, *e = hashfind(h, k, l);
+  if( e ){
+    e->v = v;
+    return;
   }
-  hashnodeinit(n, k, l, v, !f);
+  if( (h->c + 1) * 10 > h->s * _H_WAYS * 9 ) hashresize(h, 1);
+  hashnodeinit(&n, k, l, v, 0);
+  if( !isoccupied(n.f) ) return;
+  while( !hashplace(h, &n) ) hashresize(h, 1);
   (h->c)++;
-  if( h->c > h->s / 2.5 ) hashresize(h, 1);
 }
 
 Word_t hashget( struct __ht* h, Byte_t* k, int l ){
-  int n = hashfind(h, k, l, 0);
-  if( n > -1 ) return h->t[n].v;
+  struct __hn* n = hashfind(h, k, l);
+  if( n ) return n->v;
   return 0;
 }
 
-int hashfind( struct __ht* h, Byte_t* k, int l, int r ){
-  /* if r is 1, return the next occupiable slot */
-  /* otherwise just return the index if the key matches */
+struct __hn* hashfind( struct __ht* h, Byte_t* k, int l ){
   struct __hn* n;
-  unsigned hv, i = 0;
-  for( ; i < 2; i++ ){
-    if( !i ) hashfn(0, k, l, hv);
-    else     hashfn(1, k, l, hv);
-    hv %= h->s;
-    n = &(h->t[hv]);
-    if( hashmatch(n, k, l) ) return hv;
-    if( r && !isoccupied(n->f) ) return hv;
+  int i, w;
+  for( w = 0; w < 2; w++ ){
+    n = hashb(h, hashbucket(h, k, l, w));
+    for( i = 0; i < _H_WAYS; i++ )
+      if( hashmatch(&n[i], k, l) ) return &n[i];
   }
-  if( r ) return hv;
-  return -1;
+  for( i = 0; i < h->sc; i++ )
+    if( hashmatch(&(h->st[i]), k, l) ) return &(h->st[i]);
+  return NULL;
 }
 
 void hashdelete( struct __ht* h, Byte_t* k, int l ){
-  int n = hashfind(h, k, l, 0);
-  if( n == -1 ) return;
-  hashnodeclear(&(h->t[n]));
-  if( --(h->c) < h->s / 5 ) hashresize(h, 0);
+  struct __hn *n = hashfind(h, k, l), *e;
+  int i;
+  if( !n ) return;
+  hashnodeclear(n);
+  if( n >= h->st && n < h->st + _H_STASH ){
+    *n = h->st[--(h->sc)];
+    memset(&(h->st[h->sc]), 0, sizeof(struct __hn));
+  }
+  /* move stashed nodes back into the table once there is room */
+  for( i = 0; i < h->sc; ){
+    k = hashnodekey(&(h->st[i]));
+    l = h->st[i].l;
+    if( (e = hashslot(h, hashbucket(h, k, l, 0))) ) e->f = 1;
+    else if( (e = hashslot(h, hashbucket(h, k, l, 1))) ) e->f = 3;
+    if( !e ){
+      i++;
+      continue;
+    }
+    n = &(h->st[i]);
+    e->k = n->k;
+    e->v = n->v;
+    e->l = n->l;
+    *n = h->st[--(h->sc)];
+    memset(&(h->st[h->sc]), 0, sizeof(struct __hn));
+  }
+  if( --(h->c) < h->s * _H_WAYS / 8 ) hashresize(h, 0);
 }
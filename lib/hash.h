@@ -4,37 +4,46 @@
 #define Word_t unsigned long
 #define Byte_t unsigned char
 
-#define _H_ALLOC  256
+#define _H_ALLOC  256 /* initial slots */
 #define _H_WS     sizeof(Word_t)
+#define _H_WAYS   4   /* slots per bucket */
+#define _H_STASH  8   /* overflow slots */
+#define _H_KICKS  64  /* evictions before a node goes to the stash */
 
 struct __hn {
-  Byte_t k[_H_WS]; /* key */
+  union {
+    Byte_t  b[_H_WS]; /* short keys, stored inline */
+    Byte_t* p; /* long keys */
+  } k; /* key */
   Word_t v; /* value */
   int    l; /* key length */
   Byte_t f; /* flags (occupied, hash function) */
 };
 
 struct __ht {
-  struct __hn* t; /* table */
+  struct __hn* t; /* table, s buckets of _H_WAYS slots */
   int          c; /* count */
-  int          s; /* size */
+  int          s; /* size in buckets */
+  struct __hn  st[_H_STASH]; /* stash */
+  int          sc; /* stash count */
 };
 
 typedef struct __ht HashTable;
 
-void         hashw2b( Byte_t*, Word_t );
-Word_t       hashb2w( Byte_t* );
 struct __ht* hashinit( void );
 struct __ht* hashalloc( int );
+void         hashfree( struct __ht* );
 void         hashnodeinit( struct __hn*, Byte_t*, int, Word_t, int );
 int          hashmatch( struct __hn*, Byte_t*, int );
+unsigned     hashbucket( struct __ht*, Byte_t*, int, int );
+struct __hn* hashslot( struct __ht*, unsigned );
+int          hashplace( struct __ht*, struct __hn* );
 void         hashset( struct __ht*, Byte_t*, int, Word_t );
 Word_t       hashget( struct __ht*, Byte_t*, int );
 void         hashresize( struct __ht*, int );
-int          hashfind( struct __ht*, Byte_t*, int, int );
+struct __hn* hashfind( struct __ht*, Byte_t*, int );
 void         hashdelete( struct __ht*, Byte_t*, int );
 void         hashnodeclear( struct __hn* );
 Byte_t*      hashnodekey( struct __hn* );
-struct __hn* hashnodeclone( struct __hn* );
 
 #endif
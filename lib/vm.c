@@ -156,7 +156,8 @@ void vm_run( struct __vm* v ){
       
   int loops = 0;
 
-  unsigned long d, lh = 0, lcv = 0; /* pointer to last computed value */
+  unsigned long d;
+  struct __hn *lh = NULL, *lcv = NULL; /* pointer to last computed value */
   v->s = 100;
   for( ; i < v->ct; i++ ){
     word_t x = v->ins[i];
@@ -179,21 +180,21 @@ void vm_run( struct __vm* v ){
         break;
       case OP_PUSHVAL: {
         int dl = strlen((const char *)d);
-        int hv = hashfind(v->sym, (Byte_t *)d, dl, 0);
+        struct __hn* hv = hashfind(v->sym, (Byte_t *)d, dl);
         word_t o;
-        if( hv == -1 ) {
+        if( !hv ) {
           err = 1; 
           printf("Unknown variable %s\n", (char *)d); 
           break; 
         }
         lcv = hv;
-        o = v->sym->t[hv].v;
+        o = hv->v;
         push(v, o, T_INT);
       } break;
       case OP_PUSHNIL: 
         break;
       case OP_REPVAL: 
-        v->sym->t[lh].v = getval(pop(v));
+        lh->v = getval(pop(v));
         break;
       case OP_STORE: {
         word_t o = getval(pop(v));
@@ -0,0 +1,909 @@
+/*
+ * Hash table benchmarks
+ *
+ * Times every operation on the holly table (hlHashTable_t), unkeyed
+ * and keyed (hollyk, hl_hinitkeyed), and on the cuckoo table in 
+ * lib/hash.c over generated key sets and prints the mean and 
+ * percentiles in nanoseconds. Probe counts show the worst case. All 
+ * keys come from a fixed seed so runs and builds (e.g. -DHL_HPOW2) 
+ * can be compared.
+ *
+ * With -p it instead runs 1, 2, 4 .. p reader threads against one
+ * hlHashShared_t, with and without a writer, and prints throughput.
+ * With -m it compares the ordered map (hlMap_t) to filling a hash 
+ * table and sorting the keys by hand. With -s it runs 1, 2, 4 .. s 
+ * threads of mixed reads and updates on the shared ordered map 
+ * (hlMapShared_t) and on an hlMap_t behind a mutex.
+ *
+ * usage: hashbench [-n keys] [-t holly|hollyk|cuckoo] [-p threads] [-m] [-s threads]
+ */
+
+#define _POSIX_C_SOURCE 199506L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "holly.h"
+#include "../lib/hash.h"
+
+#define BENCH_ADVBITS 11 /* 2^11 colliding keys, half inserted, half missed */
+#define BENCH_BATCH   64 /* keys per batched call */
+#define BENCH_SPAN    300 /* ms each shared table or map run lasts */
+
+/*
+ * Timing
+ */
+
+static unsigned long overhead; /* cost of one timer pair */
+
+static unsigned long nsnow( void ){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (unsigned long)t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+static int cmpns( const void* a, const void* b ){
+  unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void calibrate( void ){
+  unsigned long s[1001], t;
+  int i;
+  for( i = 0; i < 1001; i++ ){
+    t = nsnow();
+    s[i] = nsnow() - t;
+  }
+  qsort(s, 1001, sizeof(unsigned long), cmpns);
+  overhead = s[500];
+}
+
+/* print the mean and percentiles of n per operation samples */
+static void report( const char* t, const char* k, const char* op, unsigned long* s, int n ){
+  double sum = 0;
+  int i;
+  for( i = 0; i < n; i++ ){
+    s[i] = s[i] > overhead ? s[i] - overhead : 0;
+    sum += s[i];
+  }
+  qsort(s, n, sizeof(unsigned long), cmpns);
+  printf("%-7s %-8s %-8s %8.1f %7lu %7lu %7lu %7lu %9lu\n", t, k, op, sum / n,
+    s[n / 2], s[(int)(n * 0.9)], s[(int)(n * 0.99)], s[(int)(n * 0.999)], s[n - 1]);
+}
+
+/*
+ * Deterministic key sets
+ */
+
+typedef struct {
+  const char*     name;
+  int             n;
+  unsigned char** k; /* keys to insert */
+  unsigned char** m; /* keys that are never inserted */
+  int*            kl;
+  int*            ml;
+} benchKeys_t;
+
+static unsigned long rs = 0x9e3779b97f4a7c15UL;
+
+static unsigned long rnd( void ){
+  rs ^= rs << 13;
+  rs ^= rs >> 7;
+  rs ^= rs << 17;
+  return rs;
+}
+
+static unsigned char* keydup( const char* s, int l ){
+  unsigned char* k = malloc(l + 1);
+  memcpy(k, s, l);
+  k[l] = 0;
+  return k;
+}
+
+static void keysalloc( benchKeys_t* ks, const char* name, int n ){
+  ks->name = name;
+  ks->n = n;
+  ks->k = malloc(n * sizeof(unsigned char*));
+  ks->m = malloc(n * sizeof(unsigned char*));
+  ks->kl = malloc(n * sizeof(int));
+  ks->ml = malloc(n * sizeof(int));
+}
+
+static void keysfree( benchKeys_t* ks ){
+  int i;
+  for( i = 0; i < ks->n; i++ ){
+    free(ks->k[i]);
+    free(ks->m[i]);
+  }
+  free(ks->k);
+  free(ks->m);
+  free(ks->kl);
+  free(ks->ml);
+}
+
+static const char ident[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+
+/*
+ * 4 to 7 character identifiers, shorter than HL_PTR_SIZE so the holly
+ * table stores them inline. Each length enumerates a permutation of
+ * its key space, misses use an upper case first letter.
+ */
+static void keysshort( benchKeys_t* ks, int n ){
+  int i, j, l;
+  char b[8];
+  keysalloc(ks, "short", n);
+  for( i = 0; i < 2 * n; i++ ){
+    unsigned long c, sp = 27;
+    l = 4 + (i >> 1) % 4;
+    for( j = 1; j < l; j++ ) sp *= 37;
+    c = ((unsigned long)(i >> 3) * 1000003UL + l) % sp;
+    b[0] = ident[c % 27];
+    for( c /= 27, j = 1; j < l; j++, c /= 37 ) b[j] = ident[c % 37];
+    if( i & 1 ){
+      b[0] = b[0] == '_' ? '@' : b[0] + 'A' - 'a';
+      ks->m[i >> 1] = keydup(b, l);
+      ks->ml[i >> 1] = l;
+    } else {
+      ks->k[i >> 1] = keydup(b, l);
+      ks->kl[i >> 1] = l;
+    }
+  }
+}
+
+/* dotted configuration paths, 25 to 40 bytes */
+static void keyslong( benchKeys_t* ks, int n ){
+  int i, l;
+  char b[64];
+  keysalloc(ks, "long", n);
+  for( i = 0; i < n; i++ ){
+    unsigned x = (unsigned)i * 2654435761u;
+    l = sprintf(b, "module%u.section%u.value_%x", x % 97, (x >> 8) % 1013, x);
+    ks->k[i] = keydup(b, l);
+    ks->kl[i] = l;
+    l = sprintf(b, "Module%u.section%u.value_%x", x % 97, (x >> 8) % 1013, x);
+    ks->m[i] = keydup(b, l);
+    ks->ml[i] = l;
+  }
+}
+
+/* "0", "1", "2", ..., misses continue from n */
+static void keysnumeric( benchKeys_t* ks, int n ){
+  int i, l;
+  char b[16];
+  keysalloc(ks, "numeric", n);
+  for( i = 0; i < n; i++ ){
+    l = sprintf(b, "%d", i);
+    ks->k[i] = keydup(b, l);
+    ks->kl[i] = l;
+    l = sprintf(b, "%d", n + i);
+    ks->m[i] = keydup(b, l);
+    ks->ml[i] = l;
+  }
+}
+
+static const char blockch[] =
+  "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_.";
+
+#ifndef HL_HPOW2
+/* hl_hsax continued from state h */
+static unsigned saxfrom( unsigned h, unsigned char* k, int l ){
+  int i;
+  for( i = 0; i < l; i++ )
+    h ^= (h << 5) + (h >> 2) + k[i];
+  return h;
+}
+
+/*
+ * Joux multicollision on hl_hsax: find two 4 byte blocks with the
+ * same state after each step, then any choice of one block per step
+ * gives the same 32 bit hash
+ */
+static void keysadversarial( benchKeys_t* ks, int n ){
+  int bits = BENCH_ADVBITS, step, i, j, l = 4 * bits;
+  unsigned long ts = 1UL << 20, found;
+  unsigned* st = malloc(ts * sizeof(unsigned));
+  unsigned char* bl = malloc(ts * 4);
+  unsigned char (*pair)[2][4] = malloc(bits * sizeof(*pair));
+  unsigned char b[4], key[4 * BENCH_ADVBITS];
+  unsigned h = 0, nh;
+  for( step = 0; step < bits; step++ ){
+    memset(bl, 0, ts * 4);
+    for( found = 0; !found; ){
+      unsigned long slot;
+      for( i = 0; i < 4; i++ ) b[i] = blockch[rnd() & 63];
+      nh = saxfrom(h, b, 4);
+      for( slot = nh & (ts - 1); bl[slot * 4]; slot = (slot + 1) & (ts - 1) ){
+        if( st[slot] == nh && memcmp(bl + slot * 4, b, 4) ){
+          memcpy(pair[step][0], bl + slot * 4, 4);
+          memcpy(pair[step][1], b, 4);
+          found = 1;
+          break;
+        }
+      }
+      if( !found ){
+        st[slot] = nh;
+        memcpy(bl + slot * 4, b, 4);
+      }
+    }
+    h = nh;
+  }
+  keysalloc(ks, "collide", n > (1 << (bits - 1)) ? 1 << (bits - 1) : n);
+  for( i = 0; i < 2 * ks->n; i++ ){
+    for( j = 0; j < bits; j++ ) memcpy(key + 4 * j, pair[j][(i >> j) & 1], 4);
+    if( i & 1 ){
+      ks->m[i >> 1] = keydup((char *)key, l);
+      ks->ml[i >> 1] = l;
+    } else {
+      ks->k[i >> 1] = keydup((char *)key, l);
+      ks->kl[i >> 1] = l;
+    }
+  }
+  free(st);
+  free(bl);
+  free(pair);
+}
+#else
+/*
+ * hl_hmix can't be inverted cheaply, settle for keys that all land
+ * in the same slot of a 2^BENCH_ADVBITS table
+ */
+static void keysadversarial( benchKeys_t* ks, int n ){
+  int i, j, l = 12;
+  unsigned mask = (1u << BENCH_ADVBITS) - 1, target = 0;
+  unsigned char key[12];
+  keysalloc(ks, "collide", n > (1 << (BENCH_ADVBITS - 1)) ? 1 << (BENCH_ADVBITS - 1) : n);
+  for( i = 0; i < 2 * ks->n; ){
+    for( j = 0; j < l; j++ ) key[j] = blockch[rnd() & 63];
+    if( (hl_hmix(key, l) & mask) != target ) continue;
+    if( i & 1 ){
+      ks->m[i >> 1] = keydup((char *)key, l);
+      ks->ml[i >> 1] = l;
+    } else {
+      ks->k[i >> 1] = keydup((char *)key, l);
+      ks->kl[i >> 1] = l;
+    }
+    i++;
+  }
+}
+#endif
+
+/* shuffled copy of 0..n-1 */
+static int* order( int n ){
+  int* o = malloc(n * sizeof(int));
+  int i, j, t;
+  for( i = 0; i < n; i++ ) o[i] = i;
+  for( i = n - 1; i > 0; i-- ){
+    j = rnd() % (i + 1);
+    t = o[i];
+    o[i] = o[j];
+    o[j] = t;
+  }
+  return o;
+}
+
+/*
+ * Tables under test
+ */
+
+typedef struct {
+  const char* name;
+  void* (*init)( void );
+  void  (*set)( void*, unsigned char*, int, void* );
+  int   (*get)( void*, unsigned char*, int );
+  void  (*del)( void*, unsigned char*, int );
+  void  (*free)( void* );
+  void  (*setmany)( void*, unsigned char**, int*, int ); /* NULL if unbatched */
+  int   (*getmany)( void*, unsigned char**, int*, int );
+  unsigned long (*probes)( void*, unsigned char*, int ); /* NULL if not probed */
+} benchTable_t;
+
+static hlState_t state;
+
+static void* hollyinit( void ){
+  hlHashTable_t* h = malloc(sizeof(hlHashTable_t));
+  *h = hl_hinit(&state);
+  return h;
+}
+
+static void* hollykinit( void ){
+  hlHashTable_t* h = malloc(sizeof(hlHashTable_t));
+  *h = hl_hinitkeyed(&state);
+  return h;
+}
+
+static void hollyset( void* h, unsigned char* k, int l, void* v ){
+  hl_hset(h, k, l, v);
+}
+
+static int hollyget( void* h, unsigned char* k, int l ){
+  return hl_hget(h, k, l) != -1;
+}
+
+static void hollydel( void* h, unsigned char* k, int l ){
+  hl_hdel(h, k, l);
+}
+
+static void hollysetmany( void* h, unsigned char** k, int* l, int n ){
+  hl_hsetmany(h, k, l, (void **)k, n);
+}
+
+static int hollygetmany( void* h, unsigned char** k, int* l, int n ){
+  int r[BENCH_BATCH], i, f = 0;
+  hl_hgetmany(h, k, l, r, n);
+  for( i = 0; i < n; i++ ) f += r[i] != -1;
+  return f;
+}
+
+static unsigned long hollyprobes( void* h, unsigned char* k, int l ){
+  return hl_hprobes(h, k, l);
+}
+
+static void hollyfree( void* h ){
+  hl_hfree(h);
+  free(h);
+}
+
+static void* cuckooinit( void ){
+  return hashinit();
+}
+
+static void cuckooset( void* h, unsigned char* k, int l, void* v ){
+  hashset(h, k, l, (Word_t)v);
+}
+
+static int cuckooget( void* h, unsigned char* k, int l ){
+  return hashget(h, k, l) != 0;
+}
+
+static void cuckoodel( void* h, unsigned char* k, int l ){
+  hashdelete(h, k, l);
+}
+
+static void cuckoofree( void* h ){
+  hashfree(h);
+}
+
+static const benchTable_t tables[] = {
+  { "holly",  hollyinit,  hollyset,  hollyget,  hollydel,  hollyfree, 
+    hollysetmany, hollygetmany, hollyprobes },
+  { "hollyk", hollykinit, hollyset,  hollyget,  hollydel,  hollyfree, 
+    hollysetmany, hollygetmany, hollyprobes },
+  { "cuckoo", cuckooinit, cuckooset, cuckooget, cuckoodel, cuckoofree, 
+    NULL, NULL, NULL }
+};
+
+#define BENCH_TABLES (int)(sizeof(tables) / sizeof(tables[0]))
+
+/*
+ * Workloads
+ */
+
+/* 
+ * the batched calls are timed per BENCH_BATCH keys, less the timer 
+ * overhead, so the "/b" rows only have a mean per key and leave the 
+ * percentile columns empty
+ */
+static unsigned long batchns( unsigned long c0 ){
+  unsigned long ns = nsnow() - c0;
+  return ns > overhead ? ns - overhead : 0;
+}
+
+static void batchreport( const char* t, const char* k, const char* op, unsigned long ns, int n ){
+  printf("%-7s %-8s %-8s %8.1f %7s %7s %7s %7s %9s\n", t, k, op, (double)ns / n,
+    "-", "-", "-", "-", "-");
+}
+
+static void runbatch( const benchTable_t* t, benchKeys_t* ks, int* o ){
+  int i, c, n = ks->n, found, *hl = malloc(n * sizeof(int));
+  unsigned char** hk = malloc(n * sizeof(unsigned char*));
+  unsigned long ns, sum;
+  void* h = t->init();
+  for( i = 0; i < n; i++ ){
+    hk[i] = ks->k[o[i]];
+    hl[i] = ks->kl[o[i]];
+  }
+
+  for( i = sum = 0; i < n; i += c ){
+    c = n - i < BENCH_BATCH ? n - i : BENCH_BATCH;
+    ns = nsnow();
+    t->setmany(h, ks->k + i, ks->kl + i, c);
+    sum += batchns(ns);
+  }
+  batchreport(t->name, ks->name, "insert/b", sum, n);
+
+  for( i = found = sum = 0; i < n; i += c ){
+    c = n - i < BENCH_BATCH ? n - i : BENCH_BATCH;
+    ns = nsnow();
+    found += t->getmany(h, hk + i, hl + i, c);
+    sum += batchns(ns);
+  }
+  batchreport(t->name, ks->name, "hit/b", sum, n);
+  if( found != n ) printf("  ! %d of %d keys found\n", found, n);
+
+  for( i = found = sum = 0; i < n; i += c ){
+    c = n - i < BENCH_BATCH ? n - i : BENCH_BATCH;
+    ns = nsnow();
+    found += t->getmany(h, ks->m + i, ks->ml + i, c);
+    sum += batchns(ns);
+  }
+  batchreport(t->name, ks->name, "miss/b", sum, n);
+  if( found ) printf("  ! %d missing keys found\n", found);
+
+  t->free(h);
+  free(hk);
+  free(hl);
+}
+
+/* mean and worst number of groups probed for each of the n keys in k */
+static void probes( const benchTable_t* t, void* h, benchKeys_t* ks, const char* op, unsigned char** k, int* l ){
+  unsigned long p, sum = 0, max = 0;
+  int i, n = ks->n;
+  for( i = 0; i < n; i++ ){
+    sum += p = t->probes(h, k[i], l[i]);
+    if( p > max ) max = p;
+  }
+  printf("%-7s %-8s %-8s %8.2f groups probed, worst %lu\n", t->name, ks->name, op, (double)sum / n, max);
+}
+
+static void run( const benchTable_t* t, benchKeys_t* ks ){
+  int i, n = ks->n, found, *o = order(n);
+  unsigned long* s = malloc(n * sizeof(unsigned long)), c;
+  void* h = t->init();
+
+  for( i = 0; i < n; i++ ){
+    c = nsnow();
+    t->set(h, ks->k[i], ks->kl[i], ks->k[i]);
+    s[i] = nsnow() - c;
+  }
+  report(t->name, ks->name, "insert", s, n);
+
+  for( i = found = 0; i < n; i++ ){
+    c = nsnow();
+    found += t->get(h, ks->k[o[i]], ks->kl[o[i]]);
+    s[i] = nsnow() - c;
+  }
+  report(t->name, ks->name, "hit", s, n);
+  if( found != n ) printf("  ! %d of %d keys found\n", found, n);
+  if( t->probes ) probes(t, h, ks, "probe/h", ks->k, ks->kl);
+
+  for( i = found = 0; i < n; i++ ){
+    c = nsnow();
+    found += t->get(h, ks->m[i], ks->ml[i]);
+    s[i] = nsnow() - c;
+  }
+  report(t->name, ks->name, "miss", s, n);
+  if( found ) printf("  ! %d missing keys found\n", found);
+  if( t->probes ) probes(t, h, ks, "probe/m", ks->m, ks->ml);
+
+  for( i = 0; i < n; i++ ){
+    c = nsnow();
+    t->del(h, ks->k[o[i]], ks->kl[o[i]]);
+    s[i] = nsnow() - c;
+  }
+  report(t->name, ks->name, "delete", s, n);
+  t->free(h);
+
+  /* 60% lookups, 20% inserts, 20% deletes over a half full table */
+  h = t->init();
+  for( i = 0; i < n / 2; i++ ) t->set(h, ks->k[i], ks->kl[i], ks->k[i]);
+  for( i = 0; i < n; i++ ){
+    int r = rnd() % 10, j = rnd() % n;
+    c = nsnow();
+    if( r < 6 ) t->get(h, ks->k[j], ks->kl[j]);
+    else if( r < 8 ) t->set(h, ks->k[j], ks->kl[j], ks->k[j]);
+    else t->del(h, ks->k[j], ks->kl[j]);
+    s[i] = nsnow() - c;
+  }
+  report(t->name, ks->name, "mixed", s, n);
+  t->free(h);
+
+  if( t->setmany ) runbatch(t, ks, o);
+  free(s);
+  free(o);
+}
+
+/* 
+ * a block scope: a fresh table with 1 to 8 names, each looked up 
+ * twice, then freed. Timed per scope 
+ */
+static void runscopes( const benchTable_t* t, benchKeys_t* ks ){
+  int i, j, c, b, n = ks->n;
+  unsigned long* s = malloc(n * sizeof(unsigned long)), ns;
+  void* h;
+  for( i = 0; i < n; i++ ){
+    b = rnd() % (n - 8);
+    c = 1 + rnd() % 8;
+    ns = nsnow();
+    h = t->init();
+    for( j = 0; j < c; j++ ) t->set(h, ks->k[b + j], ks->kl[b + j], ks->k[b + j]);
+    for( j = 0; j < 2 * c; j++ ) t->get(h, ks->k[b + j % c], ks->kl[b + j % c]);
+    t->free(h);
+    s[i] = nsnow() - ns;
+  }
+  report(t->name, "scopes", "block", s, n);
+  free(s);
+}
+
+/*
+ * Shared table scaling
+ */
+
+typedef struct {
+  pthread_t        t;
+  hlHashShared_t*  h;
+  hlMapShared_t*   mc;
+  hlMap_t*         m; /* under lk */
+  pthread_mutex_t* lk;
+  benchKeys_t*     ks;
+  unsigned long    s; /* rng state */
+  unsigned long    ops;
+  int              miss; /* lookups that failed, should stay 0 */
+} benchThread_t;
+
+static int stop;
+
+static unsigned long trnd( benchThread_t* b ){
+  b->s ^= b->s << 13;
+  b->s ^= b->s >> 7;
+  b->s ^= b->s << 17;
+  return b->s;
+}
+
+static void* reader( void* p ){
+  benchThread_t* b = p;
+  int r = hl_hcjoin(b->h), i;
+  void* v;
+  while( !__atomic_load_n(&stop, __ATOMIC_RELAXED) ){
+    i = trnd(b) % b->ks->n;
+    if( !hl_hcget(b->h, r, b->ks->k[i], b->ks->kl[i], &v) ) b->miss++;
+    b->ops++;
+  }
+  hl_hcleave(b->h, r);
+  return NULL;
+}
+
+/* inserts and deletes miss keys, so the inserted keys stay put */
+static void* writer( void* p ){
+  benchThread_t* b = p;
+  int i;
+  while( !__atomic_load_n(&stop, __ATOMIC_RELAXED) ){
+    i = trnd(b) % b->ks->n;
+    if( b->ops & 1 ) hl_hcdel(b->h, b->ks->m[i], b->ks->ml[i]);
+    else hl_hcset(b->h, b->ks->m[i], b->ks->ml[i], b->ks->m[i]);
+    b->ops++;
+  }
+  return NULL;
+}
+
+/* 
+ * run the filled in b[0..n) for BENCH_SPAN ms, the first r with rf,
+ * the rest with wf. Returns the ns taken 
+ */
+static unsigned long timethreads( benchThread_t* b, int n, int r, void* (*rf)( void* ), void* (*wf)( void* ) ){
+  struct timespec span;
+  unsigned long c;
+  int i;
+  span.tv_sec = BENCH_SPAN / 1000;
+  span.tv_nsec = (BENCH_SPAN % 1000) * 1000000L;
+  stop = 0;
+  c = nsnow();
+  for( i = 0; i < n; i++ ){
+    b[i].s = 0x9e3779b97f4a7c15UL * (i + 1);
+    pthread_create(&(b[i].t), NULL, i < r ? rf : wf, &b[i]);
+  }
+  nanosleep(&span, NULL);
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+  for( i = 0; i < n; i++ ){
+    pthread_join(b[i].t, NULL);
+    if( b[i].miss ) printf("  ! %d keys not found\n", b[i].miss);
+  }
+  return nsnow() - c;
+}
+
+/* run n readers and maybe a writer for BENCH_SPAN ms, reads/s and writes/s */
+static void runthreads( hlHashShared_t* h, benchKeys_t* ks, int n, int w, double* r, double* wr ){
+  benchThread_t* b = malloc((n + 1) * sizeof(benchThread_t));
+  unsigned long c;
+  int i;
+  memset(b, 0, (n + 1) * sizeof(benchThread_t));
+  for( i = 0; i < n + w; i++ ){
+    b[i].h = h;
+    b[i].ks = ks;
+  }
+  c = timethreads(b, n + w, n, reader, writer);
+  *r = *wr = 0;
+  for( i = 0; i < n + w; i++ ){
+    if( i < n ) *r += b[i].ops;
+    else *wr += b[i].ops;
+  }
+  *r /= c / 1e9;
+  *wr /= c / 1e9;
+  free(b);
+}
+
+static void runshared( benchKeys_t* ks, int maxt ){
+  hlHashShared_t* h = hl_hcinit();
+  double r, wr, base = 0;
+  int i, t;
+  for( i = 0; i < ks->n; i++ ) hl_hcset(h, ks->k[i], ks->kl[i], ks->k[i]);
+  printf("shared table, %d %s keys, %dms per run\n\n", ks->n, ks->name, BENCH_SPAN);
+  printf("%-8s %12s %8s %16s %12s\n", "readers", "reads/s", "scaling", "reads/s, writer", "writes/s");
+  for( t = 1; t <= maxt; t *= 2 ){
+    runthreads(h, ks, t, 0, &r, &wr);
+    if( !base ) base = r;
+    printf("%-8d %12.0f %7.2fx", t, r, r / base);
+    runthreads(h, ks, t, 1, &r, &wr);
+    printf(" %16.0f %12.0f\n", r, wr);
+  }
+  hl_hcfree(h);
+}
+
+/*
+ * Shared ordered map scaling
+ */
+
+/* 
+ * 80% lookups of inserted keys, which stay put, 10% inserts and 10% 
+ * deletes of miss keys
+ */
+static void* mixedfree( void* p ){
+  benchThread_t* b = p;
+  unsigned long r;
+  int t = hl_mcjoin(b->mc), i;
+  void* v;
+  while( !__atomic_load_n(&stop, __ATOMIC_RELAXED) ){
+    r = trnd(b);
+    i = r % b->ks->n;
+    r = (r >> 24) % 10;
+    if( r < 8 ){
+      if( !hl_mcget(b->mc, t, b->ks->k[i], b->ks->kl[i], &v) ) b->miss++;
+    } else if( r < 9 ) hl_mcset(b->mc, t, b->ks->m[i], b->ks->ml[i], b->ks->m[i]);
+    else hl_mcdel(b->mc, t, b->ks->m[i], b->ks->ml[i]);
+    b->ops++;
+  }
+  hl_mcleave(b->mc, t);
+  return NULL;
+}
+
+static void* mixedlock( void* p ){
+  benchThread_t* b = p;
+  unsigned long r;
+  int i;
+  while( !__atomic_load_n(&stop, __ATOMIC_RELAXED) ){
+    r = trnd(b);
+    i = r % b->ks->n;
+    r = (r >> 24) % 10;
+    pthread_mutex_lock(b->lk);
+    if( r < 8 ){
+      if( !hl_mget(b->m, b->ks->k[i], b->ks->kl[i]) ) b->miss++;
+    } else if( r < 9 ) hl_mset(b->m, b->ks->m[i], b->ks->ml[i], b->ks->m[i]);
+    else hl_mdel(b->m, b->ks->m[i], b->ks->ml[i]);
+    pthread_mutex_unlock(b->lk);
+    b->ops++;
+  }
+  return NULL;
+}
+
+/* ops/s of n threads running f */
+static double runmixed( benchThread_t* b, int n, void* (*f)( void* ) ){
+  unsigned long c, ops = 0;
+  int i;
+  for( i = 0; i < n; i++ ) b[i].ops = 0;
+  c = timethreads(b, n, n, f, NULL);
+  for( i = 0; i < n; i++ ) ops += b[i].ops;
+  return ops / (c / 1e9);
+}
+
+static void runmapshared( benchKeys_t* ks, int maxt ){
+  benchThread_t* b = malloc(maxt * sizeof(benchThread_t));
+  hlMapShared_t* mc = hl_mcinit(&state);
+  pthread_mutex_t lk;
+  double r, base = 0, lbase = 0;
+  hlMap_t m = hl_minit(&state);
+  int i, t = hl_mcjoin(mc);
+  for( i = 0; i < ks->n; i++ ){
+    hl_mcset(mc, t, ks->k[i], ks->kl[i], ks->k[i]);
+    hl_mset(&m, ks->k[i], ks->kl[i], ks->k[i]);
+  }
+  hl_mcleave(mc, t);
+  pthread_mutex_init(&lk, NULL);
+  memset(b, 0, maxt * sizeof(benchThread_t));
+  for( i = 0; i < maxt; i++ ){
+    b[i].mc = mc;
+    b[i].m = &m;
+    b[i].lk = &lk;
+    b[i].ks = ks;
+  }
+  printf("shared map, %d %s keys, 80%% reads, %dms per run\n\n", ks->n, ks->name, BENCH_SPAN);
+  printf("%-8s %12s %8s %12s %8s\n", "threads", "lock-free/s", "scaling", "mutex/s", "scaling");
+  for( t = 1; t <= maxt; t *= 2 ){
+    r = runmixed(b, t, mixedfree);
+    if( !base ) base = r;
+    printf("%-8d %12.0f %7.2fx", t, r, r / base);
+    r = runmixed(b, t, mixedlock);
+    if( !lbase ) lbase = r;
+    printf(" %12.0f %7.2fx\n", r, r / lbase);
+  }
+  pthread_mutex_destroy(&lk);
+  hl_mcfree(mc);
+  hl_mfree(&m);
+  free(b);
+}
+
+/*
+ * Ordered map against hash and sort
+ */
+
+static int keycmp( unsigned char* a, int al, unsigned char* b, int bl ){
+  int c = memcmp(a, b, al < bl ? al : bl);
+  return c ? c : al - bl;
+}
+
+static benchKeys_t* sorting; /* qsort has no context argument */
+
+static int cmpkey( const void* a, const void* b ){
+  int x = *(const int *)a, y = *(const int *)b;
+  return keycmp(sorting->k[x], sorting->kl[x], sorting->k[y], sorting->kl[y]);
+}
+
+/* first index in the sorted s[0..n) whose key is >= k */
+static int lower( benchKeys_t* ks, int* s, int n, unsigned char* k, int l ){
+  int lo = 0, hi = n, mid;
+  while( lo < hi ){
+    mid = (lo + hi) / 2;
+    if( keycmp(ks->k[s[mid]], ks->kl[s[mid]], k, l) < 0 ) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+static void ordreport( const char* k, const char* op, const char* how, unsigned long ns, int n ){
+  printf("%-8s %-8s %-12s %10.2f %10.1f\n", k, op, how, ns / 1e6, (double)ns / n);
+}
+
+/*
+ * build: insert every key, then visit them in order
+ * ranges: after every 1% of the inserts, visit the next 100 keys
+ *   from a random miss key
+ * floor: the largest key <= a random key with a byte appended, 
+ *   which is that key
+ */
+static void runordered( benchKeys_t* ks ){
+  int i, j, c, n = ks->n, step = n / 100 > 0 ? n / 100 : 1, *s = malloc(n * sizeof(int));
+  int *q = malloc(n * sizeof(int));
+  unsigned char b[64];
+  unsigned long ns, sum = 0;
+  hlMapNode_t* mn;
+  hlMapRange_t r;
+  hlHashTable_t h;
+  hlMap_t m;
+  sorting = ks;
+
+  ns = nsnow();
+  m = hl_minit(&state);
+  for( i = 0; i < n; i++ ) hl_mset(&m, ks->k[i], ks->kl[i], ks->k[i]);
+  for( mn = hl_mfirst(&m); mn; mn = hl_msucc(mn) ) sum += mn->l;
+  ordreport(ks->name, "build", "map", nsnow() - ns, n);
+  hl_mfree(&m);
+
+  ns = nsnow();
+  h = hl_hinit(&state);
+  for( i = 0; i < n; i++ ){
+    hl_hset(&h, ks->k[i], ks->kl[i], ks->k[i]);
+    s[i] = i;
+  }
+  qsort(s, n, sizeof(int), cmpkey);
+  for( i = 0; i < n; i++ ) sum += ks->kl[s[i]];
+  ordreport(ks->name, "build", "hash+sort", nsnow() - ns, n);
+  hl_hfree(&h);
+
+  ns = nsnow();
+  m = hl_minit(&state);
+  for( i = 0; i < n; i += step ){
+    for( j = i; j < i + step && j < n; j++ ) hl_mset(&m, ks->k[j], ks->kl[j], ks->k[j]);
+    j = rnd() % n;
+    r = hl_mrange(&m, ks->m[j], ks->ml[j], NULL, 0);
+    for( c = 0; c < 100 && (mn = hl_mnext(&r)); c++ ) sum += mn->l;
+  }
+  ordreport(ks->name, "ranges", "map", nsnow() - ns, n);
+
+  ns = nsnow();
+  h = hl_hinit(&state);
+  for( i = 0; i < n; i += step ){
+    for( j = i; j < i + step && j < n; j++ ){
+      hl_hset(&h, ks->k[j], ks->kl[j], ks->k[j]);
+      s[j] = j;
+    }
+    qsort(s, j, sizeof(int), cmpkey);
+    c = rnd() % n;
+    for( c = lower(ks, s, j, ks->m[c], ks->ml[c]); c < j && c < 100; c++ ) sum += ks->kl[s[c]];
+  }
+  ordreport(ks->name, "ranges", "hash+sort", nsnow() - ns, n);
+  hl_hfree(&h);
+
+  for( i = 0; i < n; i++ ) q[i] = rnd() % n;
+  ns = nsnow();
+  for( i = 0; i < n; i++ ){
+    memcpy(b, ks->k[q[i]], ks->kl[q[i]]);
+    b[ks->kl[q[i]]] = '!';
+    if( (mn = hl_mfloor(&m, b, ks->kl[q[i]] + 1)) ) sum += mn->l;
+  }
+  ordreport(ks->name, "floor", "map", nsnow() - ns, n);
+  hl_mfree(&m);
+
+  ns = nsnow();
+  for( i = 0; i < n; i++ ){
+    memcpy(b, ks->k[q[i]], ks->kl[q[i]]);
+    b[ks->kl[q[i]]] = '!';
+    if( (c = lower(ks, s, n, b, ks->kl[q[i]] + 1)) > 0 ) sum += ks->kl[s[c - 1]];
+  }
+  ordreport(ks->name, "floor", "sorted", nsnow() - ns, n);
+
+  if( !sum ) printf("  ! nothing visited\n");
+  free(s);
+  free(q);
+}
+
+static int usage( const char* p ){
+  fprintf(stderr, "usage: %s [-n keys] [-t holly|hollyk|cuckoo] [-p threads] [-m] [-s threads]\n", p);
+  return 1;
+}
+
+int main( int argc, char** argv ){
+  int n = 100000, i, j, only = -1, threads = 0, ordered = 0, mthreads = 0;
+  benchKeys_t ks[4];
+  for( i = 1; i < argc; i++ ){
+    if( !strcmp(argv[i], "-n") && i + 1 < argc ){
+      n = atoi(argv[++i]);
+    } else if( !strcmp(argv[i], "-m") ){
+      ordered = 1;
+    } else if( !strcmp(argv[i], "-s") && i + 1 < argc ){
+      mthreads = atoi(argv[++i]);
+    } else if( !strcmp(argv[i], "-p") && i + 1 < argc ){
+      threads = atoi(argv[++i]);
+    } else if( !strcmp(argv[i], "-t") && i + 1 < argc ){
+      for( only = 0, i++; only < BENCH_TABLES; only++ )
+        if( !strcmp(argv[i], tables[only].name) ) break;
+      if( only == BENCH_TABLES ) return usage(argv[0]);
+    } else return usage(argv[0]);
+  }
+  if( n < 16 ) n = 16;
+  calibrate();
+  hl_hseed(&state);
+  keysshort(&ks[0], n);
+  keyslong(&ks[1], n);
+  keysnumeric(&ks[2], n);
+  keysadversarial(&ks[3], n);
+  if( threads > 0 || ordered || mthreads > 0 ){
+    if( threads > 0 ) runshared(&ks[0], threads);
+    if( mthreads > 0 ) runmapshared(&ks[0], mthreads);
+    if( ordered ){
+      printf("%-8s %-8s %-12s %10s %10s\n", "keys", "op", "how", "ms", "ns/key");
+      for( j = 0; j < 3; j++ ) runordered(&ks[j]);
+    }
+    for( j = 0; j < 4; j++ ) keysfree(&ks[j]);
+    return 0;
+  }
+#ifdef HL_HPOW2
+  printf("holly table: power of two sizes, hl_hmix\n");
+#else
+  printf("holly table: prime sizes, hl_hsax\n");
+#endif
+  printf("%d keys (%d colliding), timer overhead %luns subtracted\n\n", n, ks[3].n, overhead);
+  printf("%-7s %-8s %-8s %8s %7s %7s %7s %7s %9s\n",
+    "table", "keys", "op", "mean", "p50", "p90", "p99", "p99.9", "max");
+  for( i = 0; i < BENCH_TABLES; i++ ){
+    if( only != -1 && only != i ) continue;
+    for( j = 0; j < 4; j++ ) run(&tables[i], &ks[j]);
+    runscopes(&tables[i], &ks[0]);
+  }
+  for( j = 0; j < 4; j++ ) keysfree(&ks[j]);
+#ifdef HL_HSTATS
+  printf("\n");
+  hl_hstatsdump(&state, stdout);
+#endif
+  return 0;
+}
@@ -20,10 +20,32 @@
  *      without the underscores
  * 
  */
+
+/* hl_lpar lexes on threads when built with -DHL_PTHREADS -pthread */
+#ifdef HL_PTHREADS
+#define _POSIX_C_SOURCE 199506L
+#endif
  
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef HL_PTHREADS
+#include <pthread.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* AVX2 scanning is compiled in with a target attribute, used if the CPU has it */
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HL_LAVX2
+#include <immintrin.h>
+#endif
 
 #include "holly.h"
 
@@ -67,9 +89,34 @@ enum {
   OP_LAND,
   OP_LOR,
   OP_LT,
-  OP_GT
+  OP_GT,
+  OP_MOD,
+  OP_BOR,
+  OP_BAND,
+  OP_XOR,
+  OP_LSHIFT,
+  OP_RSHIFT,
+  OP_NEQ,
+  OP_NOT,
+  OP_NEG,
+  OP_BNOT,
+  OP_LOOP, /* back arg instructions if the value popped is true */
+  OP_GETLOCAL, /* arg is the slot */
+  OP_SETLOCAL,
+  OP_GETUPVAL, /* arg is the slot << 8 | how many envs out */
+  OP_SETUPVAL,
+  OP_EXTARG /* arg is the high bits of the next one's */
 };
 
+/* 
+ * an instruction is (op << HL_ARGBITS) | arg, args that need more 
+ * bits are preceded by OP_EXTARG 
+ */
+#ifndef HL_ARGBITS
+#define HL_ARGBITS 24
+#endif
+#define HL_ARGMAX ((1U << HL_ARGBITS) - 1)
+
 enum {
   numtype,
   strtype,
@@ -77,74 +124,217 @@ enum {
   objtype,
   arraytype,
   functype,
-  niltype
+  niltype,
+  maptype
 };
 
+#define istruthy(x) ((x.t == numtype && x.v.n != 0.0f) \
+   || (x.t == booltype && x.v.b != 0) \
+   || (x.t != niltype && x.t != numtype && x.t != booltype))
+
+/* the integer part of n, 0 if a long can't hold it */
+static long hl_nlong( hlNum_t n ){
+  return n > (hlNum_t)LONG_MIN && n < (hlNum_t)LONG_MAX ? (long)n : 0;
+}
+
+/* 
+ * the number operators, for the vm and constant folding alike. The
+ * bitwise ones work on integer parts, OP_BNOT ignores r
+ */
+static hlNum_t hl_narith( int op, hlNum_t l, hlNum_t r ){
+  long a = hl_nlong(l), b = hl_nlong(r);
+  switch( op ){
+    case OP_ADD: return l + r;
+    case OP_SUB: return l - r;
+    case OP_MULT: return l * r;
+    case OP_DIV: return l / r;
+    case OP_MOD: return fmod(l, r);
+    case OP_BOR: return a | b;
+    case OP_BAND: return a & b;
+    case OP_XOR: return a ^ b;
+    case OP_LSHIFT: return (long)((unsigned long)a << (b & (8 * sizeof(long) - 1)));
+    case OP_RSHIFT: return (unsigned long)a >> (b & (8 * sizeof(long) - 1));
+    case OP_BNOT: return ~a;
+  }
+  return 0;
+}
+
+/* numbers, strings, booleans and nil are equal by value, the rest by reference */
+static int hl_vequal( hlValue_t* l, hlValue_t* r ){
+  if( l->t != r->t ) return 0;
+  switch( l->t ){
+    case numtype: return l->v.n == r->v.n;
+    case strtype: return l->v.s->l == r->v.s->l && !memcmp(l->v.s->data, r->v.s->data, l->v.s->l);
+    case booltype: return l->v.b == r->v.b;
+    case niltype: return 1;
+    case arraytype: return l->v.a.v == r->v.a.v;
+    case functype: return l->v.f == r->v.f;
+  }
+  return l->v.o == r->v.o;
+}
+
+/* room for n more instructions, 1 if there is none */
+static int igrow( hlState_t* h, hlFunc_t* f, int n ){
+  unsigned* b;
+  int m = f->is ? 2 * f->is : 16;
+  if( f->ip + n <= f->is ) return 0;
+  if( m < f->ip + n ) m = f->ip + n;
+  if( !(b = realloc(f->ins, m * sizeof(unsigned))) ){
+    hl_error(h, "malloc failure\n", NULL);
+    return 1;
+  }
+  f->ins = b;
+  f->is = m;
+  return 0;
+}
+
 static void ipush( hlState_t* h, int op, int arg ){
-  h->fs->ins[h->fs->ip++] = (op << 16) | arg;
-  /* realloc here */
+  hlFunc_t* f = h->fs;
+  if( (unsigned)arg > HL_ARGMAX ) ipush(h, OP_EXTARG, (unsigned)arg >> HL_ARGBITS);
+  if( igrow(h, f, 1) ) return;
+  f->ins[f->ip++] = ((unsigned)op << HL_ARGBITS) | ((unsigned)arg & HL_ARGMAX);
 }
 
-static void adjustarg( hlState_t* h, int off, int arg ){
-  h->fs->ins[off] &= 0xffff0000;
-  h->fs->ins[off] |= arg;
+/* OP_EXTARG prefixes arg needs */
+static int iwide( unsigned a ){
+  int n = 0;
+  for( a >>= HL_ARGBITS; a; a >>= HL_ARGBITS ) n++;
+  return n;
 }
 
-/* value stack */
-static int vpushbool( hlState_t* h, hlBool_t b ){
-  int i = h->vp++;
-  hlValue_t v;
-  v.v.b = b;
-  v.t = booltype;
-  h->vstack[i] = v;
-  return i;
+/* 
+ * set the arg of the instruction at off, pushed with 0. a wide arg 
+ * moves it and the code after up for its prefixes, their count is 
+ * returned. Jumps are relative, so those patched before stay right 
+ * unless they cross off, patch the inner ones first
+ */
+static int adjustarg( hlState_t* h, int off, int arg ){
+  hlFunc_t* f = h->fs;
+  unsigned a = arg;
+  int i, n = iwide(a);
+  if( n ){
+    if( igrow(h, f, n) ) return 0;
+    memmove(f->ins + off + n, f->ins + off, (f->ip - off) * sizeof(unsigned));
+    f->ip += n;
+  }
+  f->ins[off + n] = (f->ins[off + n] & ~HL_ARGMAX) | (a & HL_ARGMAX);
+  for( i = off + n - 1; i >= off; i-- ){
+    a >>= HL_ARGBITS;
+    f->ins[i] = ((unsigned)OP_EXTARG << HL_ARGBITS) | (a & HL_ARGMAX);
+  }
+  return n;
 }
 
-static int vpushstr( hlState_t* h, unsigned char* s, int l ){
-  int i = h->vp++;
-  hlValue_t v;
-  hlString_t* c = hl_malloc(h, sizeof(hlString_t));
-  c->data = s;
-  c->l = l;
-  v.v.s = c;
-  v.t = strtype;
-  h->vstack[i] = v;
+/* push op jumping back to ip, the distance counts its own prefixes */
+static void iback( hlState_t* h, int op, int ip ){
+  int d = h->fs->ip - ip, n = 0;
+  while( iwide(d + n) > n ) n++;
+  ipush(h, op, d + n);
+}
+
+/* 
+ * a function is compiled, give back the slack in its buffers and make
+ * its locals, nil until set
+ */
+static void funcdone( hlState_t* h, hlFunc_t* f ){
+  void* b;
+  int i;
+  if( f->ip < f->is && (b = realloc(f->ins, (f->ip ? f->ip : 1) * sizeof(unsigned))) ){
+    f->ins = b;
+    f->is = f->ip ? f->ip : 1;
+  }
+  if( f->kc < f->ks && (b = realloc(f->k, (f->kc ? f->kc : 1) * sizeof(hlValue_t))) ){
+    f->k = b;
+    f->ks = f->kc ? f->kc : 1;
+  }
+  free(f->vars);
+  f->vars = NULL;
+  f->vc = f->vs = f->vb = 0;
+  f->nest = 0;
+  if( f->sc && (f->slots = hl_malloc(h, f->sc * sizeof(hlValue_t))) ){
+    for( i = 0; i < f->sc; i++ ) f->slots[i].t = niltype;
+  }
+}
+
+/* 
+ * constant pool of the function being compiled, the index is the arg
+ * of OP_PUSHVAL and friends. numbers, strings and functions equal in
+ * type and bits share a slot, strings being interned 
+ */
+static int vpushval( hlState_t* h, hlValue_t v ){
+  hlFunc_t* f = h->fs;
+  unsigned char k[1 + sizeof(v.v)], *p;
+  int i, l = 1;
+  k[0] = (unsigned char)v.t;
+  switch( v.t ){
+    case numtype: memcpy(k + 1, &v.v.n, sizeof(hlNum_t)); l += sizeof(hlNum_t); break;
+    case strtype: memcpy(k + 1, &v.v.s, sizeof(hlString_t*)); l += sizeof(hlString_t*); break;
+    case functype: memcpy(k + 1, &v.v.f, sizeof(hlFunc_t*)); l += sizeof(hlFunc_t*); break;
+    case booltype: k[l++] = v.v.b; break;
+    case niltype: break;
+    default: l = 0; /* not a constant, never shared */
+  }
+  if( l && (i = hl_hget(&f->kmap, k, l)) != -1 ) return (int)(long)hl_hval(&f->kmap, i);
+  if( f->kc == f->ks ){
+    int n = f->ks ? 2 * f->ks : 8;
+    hlValue_t* b = realloc(f->k, n * sizeof(hlValue_t));
+    if( !b ){
+      hl_error(h, "malloc failure\n", NULL);
+      return 0;
+    }
+    f->k = b;
+    f->ks = n;
+  }
+  i = f->kc++;
+  f->k[i] = v;
+  if( l ){ /* the table keeps long keys by pointer */
+    if( !(p = hl_aalloc(&f->ka, l)) ){
+      hl_error(h, "malloc failure\n", NULL);
+      return i;
+    }
+    memcpy(p, k, l);
+    hl_hset(&f->kmap, p, l, (void *)(long)i);
+  }
   return i;
 }
 
-static int vpushnum( hlState_t* h, hlNum_t n ){
-  int i = h->vp++;
+static int vpushstr( hlState_t* h, int id ){
   hlValue_t v;
-  v.v.n = n;
-  v.t = numtype;
-  h->vstack[i] = v;
-  return i;
+  v.v.s = h->strs[id];
+  v.t = strtype;
+  return vpushval(h, v);
 }
 
 static int vpushfunc( hlState_t* h, hlFunc_t* f ){
-  int i = h->vp++;
   hlValue_t v;
   v.v.f = f;
   v.t = functype;
-  h->vstack[i] = v;
-  return i;
+  return vpushval(h, v);
 }
 
 static int vpushnil( hlState_t* h ){
-  int i = h->vp++;
   hlValue_t v;
   v.v.n = 0;
   v.t = niltype;
-  h->vstack[i] = v;
-  return i;
+  return vpushval(h, v);
 }
 
 static hlFunc_t* funcstate( hlState_t* h ){
   hlFunc_t* f = hl_malloc(h, sizeof(hlFunc_t));
   if( !f ) return NULL;
   f->estack = hl_malloc(h, 100 * sizeof(hlValue_t));
-  f->ins = hl_malloc(h, 100 * sizeof(unsigned));
+  f->ins = NULL;
+  f->is = 0;
+  f->slots = NULL;
+  f->sc = 0;
+  f->vars = NULL;
+  f->vc = f->vs = f->vb = 0;
+  f->nest = 0;
   f->locals = hl_hinit(h);
+  f->k = NULL;
+  f->kc = f->ks = 0;
+  f->kmap = hl_hinit(h);
+  memset(&f->ka, 0, sizeof(hlArena_t));
   f->ep = 0;
   f->ip = 0;
   f->state = h;
@@ -153,14 +343,31 @@ static hlFunc_t* funcstate( hlState_t* h ){
   return f;
 }
 
+static void hl_linit( void );
+
 void hl_init( hlState_t* h ){
   h->error = 0;
-  h->vstack = hl_malloc(h, 100 * sizeof(hlValue_t));
+  h->lquiet = 0;
+  hl_linit();
+  hl_hseed(h);
+#ifdef HL_HSTATS
+  memset(&h->hstats, 0, sizeof(h->hstats));
+#endif
+#ifdef HL_VSTATS
+  h->vins = 0;
+#endif
+  h->names = hl_hinit(h);
+  memset(&h->sa, 0, sizeof(hlArena_t));
+  h->strs = NULL;
+  h->sc = h->ss = 0;
+  hl_intern(h, (unsigned char *)"", 0);
   h->global = funcstate(h);
   h->fs = h->global;
   h->ctok.type = -1;
   h->ptr = 0;
-  h->vp = 0;
+  h->pend = NULL;
+  h->toks = NULL;
+  h->tp = 0;
 }
 
 /* the maximum index in the primes array
@@ -169,6 +376,80 @@ void hl_init( hlState_t* h ){
  */
 #define HL_HMAX 28
 
+/* control codes, a full slot holds the 7 bit tag of its hash */
+#define HL_HEMPTY   0x80
+#define HL_HDELETED 0xfe
+
+/* 
+ * the tag and the first slot must come from different hash bits, 
+ * hl_hsax mixes its high bits poorly so the prime tables take the
+ * low bits for the tag and let the modulo use all of them 
+ */
+#ifdef HL_HPOW2
+#define hl_htag(x)     ((unsigned char)((x) >> 25))
+#define hl_hslot(x, n) ((x) & ((n) - 1))
+#define hl_hwrap(x, n) do { x &= (n) - 1; } while( 0 )
+#define hl_hstride(p)  ((p) + HL_HGROUP) /* triangular, visits every group */
+#define hl_hash        hl_hmix
+#else
+#define hl_htag(x)     ((unsigned char)((x) & 0x7f))
+#define hl_hslot(x, n) ((x) % (n))
+#define hl_hwrap(x, n) do { while( x >= n ) x -= n; } while( 0 )
+#define hl_hstride(p)  HL_HGROUP
+#define hl_hash        hl_hsax
+#endif
+
+/* trailing zeros, and leading zeros of a 16 bit group mask */
+#if defined(__GNUC__)
+#define hl_hctz(x)   __builtin_ctz(x)
+#define hl_hclz16(x) (__builtin_clz(x) - 16)
+#else
+static int hl_hctz( unsigned x ){
+  int i = 0;
+  while( !(x & 1) ){
+    x >>= 1;
+    i++;
+  }
+  return i;
+}
+
+static int hl_hclz16( unsigned x ){
+  int i = 0;
+  while( !(x & 0x8000) ){
+    x <<= 1;
+    i++;
+  }
+  return i;
+}
+#endif
+
+/* bitmask of the control bytes in a group equal to c */
+static unsigned hl_hgmatch( unsigned char* g, unsigned char c ){
+#ifdef __SSE2__
+  __m128i v = _mm_loadu_si128((const __m128i *)g);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)c)));
+#else
+  unsigned r = 0;
+  int i;
+  for( i = 0; i < HL_HGROUP; i++ )
+    if( g[i] == c ) r |= 1u << i;
+  return r;
+#endif
+}
+
+/* bitmask of the empty or deleted slots in a group */
+static unsigned hl_hgfree( unsigned char* g ){
+#ifdef __SSE2__
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+#else
+  unsigned r = 0;
+  int i;
+  for( i = 0; i < HL_HGROUP; i++ )
+    if( g[i] & 0x80 ) r |= 1u << i;
+  return r;
+#endif
+}
+
 /* string hash function */
 unsigned hl_hsax( unsigned char* k, int l ){
   unsigned h = 0;
@@ -178,19 +459,177 @@ unsigned hl_hsax( unsigned char* k, int l ){
   return h;
 }
 
-/* create a new hash table */
+#ifdef HL_HPOW2
+/* 
+ * word at a time multiply-mix hash (wyhash style), 
+ * assumes an 8 byte unsigned long 
+ */
+#define HL_HP0 0xa0761d6478bd642fUL
+#define HL_HP1 0xe7037ed1a0b428dbUL
+#define HL_HP2 0x8ebc6af09c88c6e3UL
+
+/* xor of the high and low halves of a 128 bit product */
+static unsigned long hl_hmum( unsigned long a, unsigned long b ){
+#ifdef __SIZEOF_INT128__
+  __extension__ unsigned __int128 r = (unsigned __int128)a * b;
+  return (unsigned long)r ^ (unsigned long)(r >> 64);
+#else
+  unsigned long ah = a >> 32, al = a & 0xffffffffUL;
+  unsigned long bh = b >> 32, bl = b & 0xffffffffUL;
+  unsigned long hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+  unsigned long m = (ll >> 32) + (hl & 0xffffffffUL) + (lh & 0xffffffffUL);
+  unsigned long lo = (m << 32) | (ll & 0xffffffffUL);
+  unsigned long hi = hh + (hl >> 32) + (lh >> 32) + (m >> 32);
+  return lo ^ hi;
+#endif
+}
+
+unsigned hl_hmix( unsigned char* k, int l ){
+  unsigned long h = HL_HP0 ^ (unsigned long)l, a = 0, b = 0;
+  unsigned w0, w1;
+  int i = 0, r;
+  for( ; i + 16 <= l; i += 16 ){
+    memcpy(&a, k + i, 8);
+    memcpy(&b, k + i + 8, 8);
+    h = hl_hmum(a ^ HL_HP1, b ^ h);
+  }
+  /* 0 to 15 bytes left, read as fixed size (possibly overlapping) words */
+  k += i;
+  r = l - i;
+  if( r >= 8 ){
+    memcpy(&a, k, 8);
+    memcpy(&b, k + r - 8, 8);
+  } else if( r >= 4 ){
+    memcpy(&w0, k, 4);
+    memcpy(&w1, k + r - 4, 4);
+    a = w0;
+    b = w1;
+  } else if( r ){
+    a = ((unsigned long)k[0] << 16) | ((unsigned long)k[r >> 1] << 8) | k[r - 1];
+    b = 0;
+  } else {
+    a = b = 0;
+  }
+  h = hl_hmum(a ^ HL_HP1, b ^ h);
+  h = hl_hmum(h ^ HL_HP2, (unsigned long)l ^ HL_HP0);
+  return (unsigned)(h ^ (h >> 32));
+}
+#endif
+
+/*
+ * SipHash-1-3 keyed with the per state seed, for tables whose keys
+ * come from scripts. Without the seed an attacker can't pick keys 
+ * that share a probe sequence, which is trivial against hl_hsax. 
+ * Assumes an 8 byte unsigned long.
+ */
+#define HL_HCROUNDS 1
+#define HL_HDROUNDS 3
+
+#define hl_hrotl(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define hl_hsipround() do { \
+  v0 += v1; v1 = hl_hrotl(v1, 13); v1 ^= v0; v0 = hl_hrotl(v0, 32); \
+  v2 += v3; v3 = hl_hrotl(v3, 16); v3 ^= v2; \
+  v0 += v3; v3 = hl_hrotl(v3, 21); v3 ^= v0; \
+  v2 += v1; v1 = hl_hrotl(v1, 17); v1 ^= v2; v2 = hl_hrotl(v2, 32); \
+} while( 0 )
+
+static unsigned long hl_hsip64( unsigned long* s, unsigned char* k, int l ){
+  unsigned long v0 = 0x736f6d6570736575UL ^ s[0];
+  unsigned long v1 = 0x646f72616e646f6dUL ^ s[1];
+  unsigned long v2 = 0x6c7967656e657261UL ^ s[0];
+  unsigned long v3 = 0x7465646279746573UL ^ s[1];
+  unsigned long m, b = (unsigned long)l << 56;
+  int i, r;
+  for( i = 0; i + 8 <= l; i += 8 ){
+    memcpy(&m, k + i, 8);
+    v3 ^= m;
+    for( r = 0; r < HL_HCROUNDS; r++ ) hl_hsipround();
+    v0 ^= m;
+  }
+  for( r = 0; i + r < l; r++ )
+    b |= (unsigned long)k[i + r] << (8 * r);
+  v3 ^= b;
+  for( r = 0; r < HL_HCROUNDS; r++ ) hl_hsipround();
+  v0 ^= b;
+  v2 ^= 0xff;
+  for( r = 0; r < HL_HDROUNDS; r++ ) hl_hsipround();
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+unsigned hl_hsip( unsigned long* s, unsigned char* k, int l ){
+  unsigned long h = hl_hsip64(s, k, l);
+  return (unsigned)(h ^ (h >> 32));
+}
+
+/* 
+ * fill the state's seed from the system, or failing that from 
+ * whatever differs between runs and states
+ */
+void hl_hseed( hlState_t* h ){
+  static unsigned long n = 0;
+  unsigned long e[4], z[2] = { 0, 0 };
+  FILE* f = fopen("/dev/urandom", "rb");
+  if( f ){
+    int ok = fread(h->seed, sizeof(h->seed), 1, f) == 1;
+    fclose(f);
+    if( ok ) return;
+  }
+  e[0] = (unsigned long)time(NULL);
+  e[1] = (unsigned long)clock();
+  e[2] = (unsigned long)h;
+  e[3] = ++n;
+  z[0] = h->seed[0] = hl_hsip64(z, (unsigned char *)e, sizeof(e));
+  h->seed[1] = hl_hsip64(z, (unsigned char *)e, sizeof(e));
+}
+
+/* the hash of key s in table h */
+#define hl_hhash(h, s, l) ((h)->k ? hl_hsip((h)->state->seed, s, l) : hl_hash(s, l))
+
+/* allocate the slot and control arrays for size index s */
+static void hl_halloc( hlHashTable_t* h, int s ){
+  unsigned long n = hl_hsize(s);
+  h->s = s;
+  h->t = hl_malloc(h->state, n * sizeof(hlHashEl_t));
+  h->m = hl_malloc(h->state, n + HL_HGROUP - 1);
+  if( h->m ) memset(h->m, HL_HEMPTY, n + HL_HGROUP - 1);
+}
+
+/* 
+ * create a new hash table, most scopes hold a handful of names so 
+ * the first HL_HSMALL entries live in h.e and are found by scanning 
+ * their cached hashes, the arrays are only allocated past that
+ */
 hlHashTable_t hl_hinit( hlState_t* s ){
   hlHashTable_t h;
+  h.s = 0;
   h.c = 0;
+  h.d = 0;
   h.f = 0;
-  h.s = 0; /* index in the prime table */
-  h.t = hl_malloc(s, hlhprimes[0] * sizeof(hlHashEl_t));
+  h.os = 0;
+  h.op = 0;
+  h.t = NULL;
+  h.m = NULL;
+  h.ot = NULL;
+  h.om = NULL;
+  h.k = 0;
   h.state = s;
+#ifdef HL_HSTATS
+  memset(&h.st, 0, sizeof(h.st));
+  if( s ) s->hstats.tables++;
+#endif
   return h;
 } 
 
+/* create a table for keys from untrusted input, hashed with the seed */
+hlHashTable_t hl_hinitkeyed( hlState_t* s ){
+  hlHashTable_t h = hl_hinit(s);
+  h.k = 1;
+  return h;
+}
+
 /* create a hash table node */
-hlHashEl_t hl_hinitnode( unsigned char* k, int l, void* v ){
+hlHashEl_t hl_hinitnode( unsigned char* k, int l, void* v, unsigned hv ){
   hlHashEl_t n;
   if( l < HL_PTR_SIZE ){
     memcpy(n.k.skey, k, l);
@@ -199,10 +638,13 @@ hlHashEl_t hl_hinitnode( unsigned char* k, int l, void* v ){
   }
   n.l = l;
   n.v = v;
-  n.h = hl_hsax(k, l);
+  n.h = hv;
   return n;
 }
 
+/* the key bytes of a node */
+#define hl_hkey(n) ((n)->l < HL_PTR_SIZE ? (n)->k.skey : (n)->k.lkey)
+
 /* check if a node matches a key */
 int hl_hmatch( hlHashEl_t* n, unsigned char* k, int l ){
   unsigned char* c;
@@ -215,122 +657,1156 @@ int hl_hmatch( hlHashEl_t* n, unsigned char* k, int l ){
   return !(memcmp(c, k, l));
 }
 
-/* resize a hash table either up or down */
-void hl_hresize( hlHashTable_t* h, int dir ){
-  hlHashEl_t* t = h->t;
-  int slot, idx;
-  unsigned long ns, i = 0, j, s = hlhprimes[h->s];
-  h->s += dir;
-  ns = hlhprimes[h->s];
-  h->t = hl_malloc(h->state, hlhprimes[h->s] * sizeof(hlHashEl_t));
-  for( ; i < s; i++ ){ /* for each node in the old array */
-    if( !t[i].l )
-      continue;
-    slot = t[i].h % ns;
-    for( j = 0; j < ns; j++ ){ /* insert into the new array */
-      idx = (slot + j * j) % ns; /* probe for new slot */
-      if( h->t[idx].l )
-        continue;
-      h->t[idx] = t[i];
-      break;
+/* find a key among the inline entries, or -1 */
+static long hl_hscan( hlHashTable_t* h, unsigned char* k, int l, unsigned hv ){
+  unsigned i;
+  for( i = 0; i < h->c; i++ )
+    if( h->e[i].h == hv && hl_hmatch(&(h->e[i]), k, l) )
+      return i;
+  return -1;
+}
+
+/* write a control byte, keeping the mirrored tail in sync */
+static void hl_hsetctrl( unsigned char* m, unsigned long n, unsigned long i, unsigned char c ){
+  m[i] = c;
+  for( i += n; i < n + HL_HGROUP - 1; i += n )
+    m[i] = c;
+}
+
+/* 
+ * probe a group at a time, a group is the HL_HGROUP control bytes
+ * starting at pos, so ceil(n / HL_HGROUP) probes cover the table
+ */
+
+/* 
+ * find the slot holding a key in one pair of arrays, or -1. 
+ * The number of groups probed goes to pr unless it is NULL 
+ */
+static long hl_hfind( 
+  hlHashEl_t* t, unsigned char* m, unsigned long n, 
+  unsigned char* k, int l, unsigned hv, unsigned long* pr 
+){
+  unsigned long pos = hl_hslot(hv, n), p, i;
+  unsigned char tag = hl_htag(hv);
+  unsigned mask;
+  for( p = 0; p < n; p += HL_HGROUP ){
+    unsigned char* g = m + pos;
+    for( mask = hl_hgmatch(g, tag); mask; mask &= mask - 1 ){
+      i = pos + hl_hctz(mask);
+      hl_hwrap(i, n);
+      if( t[i].h == hv && hl_hmatch(&(t[i]), k, l) ){
+        if( pr ) *pr = p / HL_HGROUP + 1;
+        return i;
+      }
     }
+    /* an empty slot ends the probe sequence */
+    if( hl_hgmatch(g, HL_HEMPTY) ) break;
+    pos += hl_hstride(p);
+    hl_hwrap(pos, n);
   }
-  free(t);
+  if( pr ) *pr = p / HL_HGROUP + (p < n);
+  return -1;
 }
 
-/* add entry to the hash table */
-void hl_hset( hlHashTable_t* h, unsigned char* k, int l, void* v ){
-  int idx;
-  hlHashEl_t n = hl_hinitnode(k, l, v);
-  unsigned long i, s = hlhprimes[h->s];
-  unsigned slot = n.h % s;
+/* find the first empty or deleted slot in the probe sequence of hv */
+static long hl_hvacant( unsigned char* m, unsigned long n, unsigned hv ){
+  unsigned long pos = hl_hslot(hv, n), p, i;
+  unsigned mask;
+  for( p = 0; p < n; p += HL_HGROUP ){
+    if( (mask = hl_hgfree(m + pos)) ){
+      i = pos + hl_hctz(mask);
+      hl_hwrap(i, n);
+      return i;
+    }
+    pos += hl_hstride(p);
+    hl_hwrap(pos, n);
+  }
+  return -1;
+}
+
+/*
+ * Resizing is incremental. hl_hresize allocates the new arrays and
+ * keeps the old ones in h->ot/h->om, then every hl_hset, hl_hget and
+ * hl_hdel moves the next HL_HSTEP old slots across. Keys that are
+ * looked up before their turn are moved on demand, so a slot index
+ * returned by hl_hget always refers to h->t. 
+ * Building with -DHL_HSTEP=0 rehashes in one step instead.
+ */
+#ifndef HL_HSTEP
+#define HL_HSTEP 16
+#endif
+
+/* 
+ * grow above 3/4 full and shrink below 1/8, the table lands at 3/8 
+ * or 1/4 after a resize, well away from either threshold. 
+ * Tombstones count towards the grow threshold so misses always find
+ * an empty slot quickly, once they make up 1/8 of the table they are
+ * purged by a same size resize instead of growing.
+ */
+#define hl_hgrow(c, n)   ((c) >= (n) - ((n) >> 2))
+#define hl_hshrink(c, n) ((c) < ((n) >> 3))
+#define hl_hpurge(d, n)  ((d) && (d) >= ((n) >> 3))
+
+#ifdef HL_HSTATS
+/* the table's own stats, then the run totals of its state */
+static int hl_hsets( hlHashTable_t* h, hlHashStats_t** s ){
+  s[0] = &(h->st);
+  s[1] = h->state ? &(h->state->hstats) : NULL;
+  return s[1] ? 2 : 1;
+}
+
+static void hl_hsprobe( hlHashTable_t* h, unsigned long g, int hit ){
+  hlHashStats_t* s[2];
+  int i, n = hl_hsets(h, s);
+  for( i = 0; i < n; i++ ){
+    s[i]->probes[(g < HL_HSBINS ? g : HL_HSBINS) - 1]++;
+    if( hit ) s[i]->hits++;
+    else s[i]->misses++;
+  }
+}
+
+static void hl_hspeak( hlHashTable_t* h ){
+  hlHashStats_t* s[2];
+  int i, n = hl_hsets(h, s);
+  for( i = 0; i < n; i++ )
+    if( h->c > s[i]->peak ) s[i]->peak = h->c;
+}
+
+/* charge the time since t0 to resizing, r counts a new resize */
+static void hl_hsclock( hlHashTable_t* h, clock_t t0, int r ){
+  double t = (double)(clock() - t0) / CLOCKS_PER_SEC;
+  hlHashStats_t* s[2];
+  int i, n = hl_hsets(h, s);
+  for( i = 0; i < n; i++ ){
+    s[i]->resizes += r;
+    s[i]->rtime += t;
+    if( t > s[i]->rmax ) s[i]->rmax = t;
+  }
+}
+#else
+#define hl_hsprobe(h, g, hit) ((void)0)
+#define hl_hspeak(h)          ((void)0)
+#endif
+
+/* store a node in the first free slot of its probe sequence */
+static long hl_hplace( hlHashTable_t* h, hlHashEl_t* e ){
+  unsigned long n = hl_hsize(h->s);
+  long idx = hl_hvacant(h->m, n, e->h); /* the hash is cached, no rehashing */
+  if( h->m[idx] == HL_HDELETED ) h->d--; /* reuse the tombstone */
+  h->t[idx] = *e;
+  hl_hsetctrl(h->m, n, idx, hl_htag(e->h));
+  return idx;
+}
+
+/* move old slot i into the new arrays */
+static long hl_hmoveslot( hlHashTable_t* h, unsigned long i ){
+  long idx = hl_hplace(h, &(h->ot[i]));
+  hl_hsetctrl(h->om, hl_hsize(h->os), i, HL_HDELETED);
+  return idx;
+}
+
+/* move up to steps old slots, freeing the old arrays when done */
+static void hl_hmove( hlHashTable_t* h, unsigned long steps ){
+  unsigned long n = hl_hsize(h->os);
+#ifdef HL_HSTATS
+  clock_t t0 = clock();
+#endif
+  for( ; steps && h->op < n; steps--, h->op++ ){
+    if( !(h->om[h->op] & 0x80) )
+      hl_hmoveslot(h, h->op);
+  }
+  if( h->op == n ){
+    free(h->ot);
+    free(h->om);
+    h->ot = NULL;
+    h->om = NULL;
+  }
+#ifdef HL_HSTATS
+  hl_hsclock(h, t0, 0);
+#endif
+}
+
+/* find the slot of a key in h->t, pulling it out of the old arrays */
+static long hl_hlookup( hlHashTable_t* h, unsigned char* k, int l, unsigned hv ){
+  unsigned long g = 1, og = 0; /* groups probed in the new and old arrays */
+  long i;
+  if( !h->t ){
+    i = hl_hscan(h, k, l, hv);
+  } else if( (i = hl_hfind(h->t, h->m, hl_hsize(h->s), k, l, hv, &g)) == -1 && h->om ){
+    i = hl_hfind(h->ot, h->om, hl_hsize(h->os), k, l, hv, &og);
+    if( i != -1 ) i = hl_hmoveslot(h, i);
+  }
+  hl_hsprobe(h, g + og, i != -1);
+  return i;
+}
+
+/* 
+ * resize a hash table either up or down, 1 if the new arrays can't be
+ * allocated, which leaves the table in its old ones
+ */
+int hl_hresize( hlHashTable_t* h, int dir ){
+#ifdef HL_HSTATS
+  clock_t t0;
+#endif
+  /* a pending resize is finished first, the new arrays hold every key */
+  if( h->om ) hl_hmove(h, -1);
+#ifdef HL_HSTATS
+  t0 = clock();
+#endif
+  h->ot = h->t;
+  h->om = h->m;
+  h->os = h->s;
+  h->op = 0;
+  hl_halloc(h, h->s + dir);
+  if( !h->t || !h->m ){ /* keep the old arrays, hl_malloc set the error */
+    free(h->t);
+    free(h->m);
+    h->t = h->ot;
+    h->m = h->om;
+    h->s = h->os;
+    h->ot = NULL;
+    h->om = NULL;
+    return 1;
+  }
+  h->d = 0;
+#ifdef HL_HSTATS
+  hl_hsclock(h, t0, 1);
+#endif
+  if( !HL_HSTEP ) hl_hmove(h, -1);
+  return 0;
+}
+
+/* the smallest size index from s up that holds n keys without growing */
+static int hl_hfit( unsigned long n, int s ){
+  while( s < HL_HMAX && hl_hgrow(n, hl_hsize(s)) ) s++;
+  return s;
+}
+
+/* 
+ * move the inline entries into arrays sized for n keys, 1 if they 
+ * can't be allocated, which leaves the entries inline
+ */
+static int hl_hspill( hlHashTable_t* h, unsigned long n ){
+  unsigned i;
+#ifdef HL_HSTATS
+  clock_t t0 = clock();
+#endif
+  hl_halloc(h, hl_hfit(n, 0));
+  if( !h->t || !h->m ){
+    free(h->t);
+    free(h->m);
+    h->t = NULL;
+    h->m = NULL;
+    h->s = 0;
+    return 1;
+  }
+  for( i = 0; i < h->c; i++ )
+    hl_hplace(h, &(h->e[i]));
+#ifdef HL_HSTATS
+  hl_hsclock(h, t0, 1);
+#endif
+  return 0;
+}
+
+/* add a node whose hash is already computed */
+static void hl_hput( hlHashTable_t* h, hlHashEl_t* n ){
+  long idx;
+  unsigned long s;
   if( h->f ) return; /* table is full */
-  if( !l ) return;
-  if( !h->t[slot].l ){
-    h->t[slot] = n;
-    h->c++;
-  } else {
-    for( i = 0; i < s; i++ ){
-      idx = (slot + i * i) % s;
-      if( h->t[idx].l )
-        continue;
-      h->t[idx] = n;
-      h->c++;
-      break;
+  if( !h->t ){
+    if( (idx = hl_hscan(h, hl_hkey(n), n->l, n->h)) != -1 ){
+      h->e[idx].v = n->v;
+      return;
+    }
+    if( h->c < HL_HSMALL ){
+      h->e[h->c++] = *n;
+      hl_hspeak(h);
+      return;
     }
+    if( hl_hspill(h, HL_HSMALL + 1) ) return;
+  }
+  if( h->om ) hl_hmove(h, HL_HSTEP);
+  if( (idx = hl_hlookup(h, hl_hkey(n), n->l, n->h)) != -1 ){
+    h->t[idx].v = n->v;
+    return;
   }
-  if( h->c >= (s/2) ){
-    if( h->s == HL_HMAX ){
-      h->f = 1;
+  hl_hplace(h, n);
+  h->c++;
+  hl_hspeak(h);
+  s = hl_hsize(h->s);
+  if( hl_hgrow(h->c + h->d, s) ){
+    /* no room to grow into, until a delete */
+    if( hl_hpurge(h->d, s) ){
+      if( hl_hresize(h, 0) ) h->f = 1;
       return;
     }
-    hl_hresize(h, 1);
+    if( h->s == HL_HMAX || hl_hresize(h, 1) ) h->f = 1;
   }
 }
 
+/* add entry to the hash table */
+void hl_hset( hlHashTable_t* h, unsigned char* k, int l, void* v ){
+  hlHashEl_t n;
+  if( !l ) return;
+  n = hl_hinitnode(k, l, v, hl_hhash(h, k, l));
+  hl_hput(h, &n);
+}
+
 /* find the slot of the node */
 int hl_hget( hlHashTable_t* h, unsigned char* k, int l ){
-  int idx;
-  unsigned long i, s = hlhprimes[h->s];
-  unsigned slot = hl_hsax(k, l) % s;
-  if( hl_hmatch(&(h->t[slot]), k, l) )
-    return slot;
-  for( i = 0; i < s; i++ ){
-    idx = (slot + i * i) % s;
-    if( hl_hmatch(&(h->t[idx]), k, l) )
-      return idx;
+  if( h->om ) hl_hmove(h, HL_HSTEP);
+  return hl_hlookup(h, k, l, hl_hhash(h, k, l));
+}
+
+/* 
+ * groups a lookup of k probes in the current arrays, inline entries 
+ * count as one. For checking the worst case, not on hot paths 
+ */
+unsigned long hl_hprobes( hlHashTable_t* h, unsigned char* k, int l ){
+  unsigned long g = 1;
+  if( h->t ) 
+    hl_hfind(h->t, h->m, hl_hsize(h->s), k, l, hl_hhash(h, k, l), &g);
+  return g;
+}
+
+/* size the table for n keys now so filling it never resizes */
+void hl_hreserve( hlHashTable_t* h, unsigned long n ){
+  int s;
+  if( !h->t ){
+    if( n > HL_HSMALL ) hl_hspill(h, n);
+    return;
   }
-  return -1;
+  s = hl_hfit(n, h->s);
+  if( s <= h->s ) return;
+  hl_hresize(h, s - h->s);
+  if( h->om ) hl_hmove(h, -1);
+}
+
+/*
+ * The batch calls hash HL_HBATCH keys and prefetch their first groups
+ * before probing any of them, so the cache misses overlap instead of
+ * each probe waiting on the last.
+ */
+#define HL_HBATCH 16
+
+#if defined(__GNUC__)
+#define hl_hprefetch(p) __builtin_prefetch(p)
+#else
+#define hl_hprefetch(p) ((void)0)
+#endif
+
+/* prefetch the first group and slot of a hash */
+#define hl_hwarm(h, hv) do { \
+  unsigned long hl_i = hl_hslot(hv, hl_hsize((h)->s)); \
+  hl_hprefetch((h)->m + hl_i); \
+  hl_hprefetch((h)->t + hl_i); \
+} while( 0 )
+
+/* add n entries, the table is reserved for all of them up front */
+void hl_hsetmany( hlHashTable_t* h, unsigned char** k, int* l, void** v, int n ){
+  hlHashEl_t b[HL_HBATCH];
+  int i, j, c;
+  hl_hreserve(h, h->c + h->d + n);
+  for( i = 0; i < n; i += c ){
+    c = n - i < HL_HBATCH ? n - i : HL_HBATCH;
+    for( j = 0; j < c; j++ ){
+      b[j] = hl_hinitnode(k[i + j], l[i + j], v[i + j], hl_hhash(h, k[i + j], l[i + j]));
+      if( h->t ) hl_hwarm(h, b[j].h);
+    }
+    for( j = 0; j < c; j++ )
+      if( b[j].l ) hl_hput(h, &b[j]);
+  }
+}
+
+/* look up n keys, r[i] is the slot of k[i] or -1 */
+void hl_hgetmany( hlHashTable_t* h, unsigned char** k, int* l, int* r, int n ){
+  unsigned hv[HL_HBATCH];
+  int i, j, c;
+  for( i = 0; i < n; i += c ){
+    c = n - i < HL_HBATCH ? n - i : HL_HBATCH;
+    for( j = 0; j < c; j++ ){
+      hv[j] = hl_hhash(h, k[i + j], l[i + j]);
+      if( h->t ) hl_hwarm(h, hv[j]);
+    }
+    for( j = 0; j < c; j++ ){
+      if( h->om ) hl_hmove(h, HL_HSTEP);
+      r[i + j] = hl_hlookup(h, k[i + j], l[i + j], hv[j]);
+    }
+  }
+}
+
+/* 
+ * a slot can go back to empty instead of becoming a tombstone when 
+ * no probe window can have passed over it, i.e. the run of non-empty
+ * slots around it is shorter than a group 
+ */
+static int hl_hneverfull( hlHashTable_t* h, unsigned long i ){
+  unsigned long n = hl_hsize(h->s);
+  unsigned long b = i + n * (HL_HGROUP / n + 1) - HL_HGROUP;
+  unsigned before, after;
+  hl_hwrap(b, n);
+  before = hl_hgmatch(h->m + b, HL_HEMPTY);
+  after = hl_hgmatch(h->m + i, HL_HEMPTY);
+  return before && after && 
+    hl_hclz16(before) + hl_hctz(after) < HL_HGROUP;
 }
 
 /* remove an item from the table */
 void hl_hdel( hlHashTable_t* h, unsigned char* k, int l ){
   int i = hl_hget(h, k, l);
-  unsigned long s = hlhprimes[h->s];
+  unsigned long s = hl_hsize(h->s);
   if( i == -1 ) return;  
+  if( !h->t ){
+    h->e[i] = h->e[--h->c]; /* the last entry takes the hole */
+    return;
+  }
   /* possibly free the key */
   memset(&(h->t[i]), 0, sizeof(hlHashEl_t));
+  if( hl_hneverfull(h, i) ){
+    hl_hsetctrl(h->m, s, i, HL_HEMPTY);
+  } else {
+    hl_hsetctrl(h->m, s, i, HL_HDELETED); /* keep later keys in the chain reachable */
+    h->d++;
+  }
   h->c--;
   h->f = 0; /* table is no longer full */
-  if( h->c < s/4 ){
-    if( h->s == 0 ) return;
+  if( hl_hshrink(h->c, s) && h->s > 0 ){
     hl_hresize(h, -1);
+  } else if( h->d >= (s >> 2) ){
+    hl_hresize(h, 0); /* deletes alone left too many tombstones */
   }
 }
 
-/*
- * end hash table
- */ 
- 
-/*
- * Parser
- */
+/* release the table arrays, keys and values belong to the caller */
+void hl_hfree( hlHashTable_t* h ){
+  free(h->t);
+  free(h->m);
+  free(h->ot);
+  free(h->om);
+  h->t = h->ot = NULL;
+  h->m = h->om = NULL;
+  h->c = h->d = 0;
+}
 
-typedef enum {
-  tk_oeq,    tk_meq,    tk_peq,    tk_teq,     tk_xeq,    tk_deq,    
-  tk_modeq,  tk_rseq,   tk_lseq,   tk_aeq,     tk_leq,    tk_geq,        
-  tk_ls,     tk_rs,     tk_esc,    tk_lbrc,   
-  tk_rbrc,   tk_lbrk,   tk_rbrk,   tk_col,     tk_lp,     tk_rp,     
-  tk_sem,    tk_com,    tk_dcol,   tk_spr,     tk_per,    tk_arrow,  
-  tk_not,    tk_lnot,   tk_ast,    tk_bor,     tk_sub,    tk_add,    
-  tk_xor,    tk_div,    tk_mod,    tk_gt,      tk_lt,     tk_band,   
-  tk_iseq,   tk_eq,     tk_let,    tk_if,      tk_else,   tk_return, 
-  tk_while,  tk_fn,     tk_true,   tk_false,   tk_nil,    tk_for,    
-  tk_in,     tk_break,  tk_land,   tk_lor,     tk_str,    tk_num,     
-  tk_array,  tk_new, tk_bool,   tk_function, tk_Nil,   tk_log, /* temporary */
-  tk_struct, tk_use, tk_string,  tk_number, tk_boolean,
-  tk_name,   tk_eof
-} token;
+#ifdef HL_HSTATS
+/* a copy of the table's stats with its current size */
+hlHashStats_t hl_hstats( hlHashTable_t* h ){
+  hlHashStats_t s = h->st;
+  s.count = h->c;
+  s.size = h->t ? hl_hsize(h->s) : HL_HSMALL;
+  return s;
+}
 
-static const int tkSymCnt = 42;
-static const int tkCnt = 66;
+/* print the hash table totals of a run */
+void hl_hstatsdump( hlState_t* h, FILE* f ){
+  hlHashStats_t* s = &(h->hstats);
+  unsigned long n = s->hits + s->misses;
+  int i;
+  fprintf(f, "hash tables: %lu created, largest held %lu keys\n", s->tables, s->peak);
+  fprintf(f, "lookups: %lu, %lu hits, %lu misses\n", n, s->hits, s->misses);
+  fprintf(f, "groups probed:");
+  for( i = 0; i < HL_HSBINS; i++ )
+    if( s->probes[i] ) 
+      fprintf(f, " %d%s:%lu", i + 1, i == HL_HSBINS - 1 ? "+" : "", s->probes[i]);
+  fprintf(f, "\nresizes: %lu, %.6fs in all, longest step %.6fs\n", 
+    s->resizes, s->rtime, s->rmax);
+}
+#endif
 
-static const char* hlTkns[] = {
-  "|=", "-=", "+=", "*=", "^=", "/=", "%=", ">>=",
-  "<<=", "&=", "<=", ">=", "<<", ">>",
-  "\\", "{", "}", "[", "]", ":", "(", ")", ";", ",",
-  "::", "..", ".", "->", "!", "~", "*", "|", "-",
-  "+", "^", "/", "%", ">", "<", "&", "==", "=", "let",
+#ifdef __GNUC__
+/* 
+ * seqlock writer side, readers that copied a slot between the two 
+ * see a different count and retry 
+ */
+#define hl_hcbegin(h) do { \
+  __atomic_store_n(&(h)->seq, (h)->seq + 1, __ATOMIC_RELAXED); \
+  __atomic_thread_fence(__ATOMIC_RELEASE); \
+} while( 0 )
+
+#define hl_hcend(h) __atomic_store_n(&(h)->seq, (h)->seq + 1, __ATOMIC_RELEASE)
+
+static hlHashArr_t* hl_hcalloc( int s ){
+  hlHashArr_t* a = malloc(sizeof(hlHashArr_t));
+  if( !a ) return NULL;
+  a->s = s;
+  a->n = hl_hsize(s);
+  a->t = malloc(a->n * sizeof(hlHashEl_t));
+  a->m = malloc(a->n + HL_HGROUP - 1);
+  a->e = 0;
+  a->next = NULL;
+  if( !a->t || !a->m ){
+    free(a->t);
+    free(a->m);
+    free(a);
+    return NULL;
+  }
+  memset(a->m, HL_HEMPTY, a->n + HL_HGROUP - 1);
+  return a;
+}
+
+static void hl_hcrelease( hlHashArr_t* a ){
+  free(a->t);
+  free(a->m);
+  free(a);
+}
+
+hlHashShared_t* hl_hcinit( void ){
+  hlHashShared_t* h = malloc(sizeof(hlHashShared_t));
+  if( !h ) return NULL;
+  memset(h, 0, sizeof(hlHashShared_t));
+  h->epoch = 1; /* 0 marks a reader outside the table */
+  if( !(h->a = hl_hcalloc(0)) ){
+    free(h);
+    return NULL;
+  }
+  return h;
+}
+
+/* take a reader slot for the calling thread, or -1 if all are taken */
+int hl_hcjoin( hlHashShared_t* h ){
+  unsigned long z;
+  int i;
+  for( i = 0; i < HL_HCREADERS; i++ ){
+    z = 0;
+    if( __atomic_compare_exchange_n(&(h->r[i].u), &z, 1, 0, 
+          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+      return i;
+  }
+  return -1;
+}
+
+void hl_hcleave( hlHashShared_t* h, int r ){
+  __atomic_store_n(&(h->r[r].u), 0, __ATOMIC_RELEASE);
+}
+
+/* free the retired arrays no reader can still be using */
+static void hl_hcreclaim( hlHashShared_t* h ){
+  unsigned long e, min = (unsigned long)-1;
+  hlHashArr_t **p = &(h->old), *a;
+  int i;
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for( i = 0; i < HL_HCREADERS; i++ ){
+    e = __atomic_load_n(&(h->r[i].e), __ATOMIC_ACQUIRE);
+    if( e && e < min ) min = e;
+  }
+  while( (a = *p) ){
+    if( a->e < min ){
+      *p = a->next;
+      hl_hcrelease(a);
+    } else p = &(a->next);
+  }
+}
+
+/* rehash into arrays of size index s and retire the current ones */
+static void hl_hcresize( hlHashShared_t* h, int s ){
+  hlHashArr_t *o = h->a, *a = hl_hcalloc(s);
+  unsigned long i;
+  long j;
+  if( !a ) return;
+  for( i = 0; i < o->n; i++ ){
+    if( o->m[i] & 0x80 ) continue;
+    j = hl_hvacant(a->m, a->n, o->t[i].h);
+    a->t[j] = o->t[i];
+    hl_hsetctrl(a->m, a->n, j, o->m[i]);
+  }
+  h->d = 0;
+  __atomic_store_n(&(h->a), a, __ATOMIC_RELEASE);
+  /* readers that enter from here on see a */
+  o->e = h->epoch;
+  __atomic_store_n(&(h->epoch), h->epoch + 1, __ATOMIC_SEQ_CST);
+  o->next = h->old;
+  h->old = o;
+  hl_hcreclaim(h);
+}
+
+/* 
+ * one lookup attempt, 1 if found, 0 if not, -1 if the writer got in 
+ * the way. Slots are copied before their key is compared so a slot 
+ * being rewritten is never followed 
+ */
+static int hl_hcfind( hlHashShared_t* h, unsigned char* k, int l, unsigned hv, void** v ){
+  unsigned long s0 = __atomic_load_n(&(h->seq), __ATOMIC_ACQUIRE), pos, p, i;
+  unsigned char tag = hl_htag(hv);
+  hlHashArr_t* a;
+  hlHashEl_t e;
+  unsigned mask;
+  if( s0 & 1 ) return -1;
+  a = __atomic_load_n(&(h->a), __ATOMIC_ACQUIRE);
+  pos = hl_hslot(hv, a->n);
+  for( p = 0; p < a->n; p += HL_HGROUP ){
+    unsigned char* g = a->m + pos;
+    for( mask = hl_hgmatch(g, tag); mask; mask &= mask - 1 ){
+      i = pos + hl_hctz(mask);
+      hl_hwrap(i, a->n);
+      e = a->t[i];
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if( __atomic_load_n(&(h->seq), __ATOMIC_RELAXED) != s0 ) return -1;
+      if( e.h == hv && hl_hmatch(&e, k, l) ){
+        *v = e.v;
+        return 1;
+      }
+    }
+    if( hl_hgmatch(g, HL_HEMPTY) ) break;
+    pos += hl_hstride(p);
+    hl_hwrap(pos, a->n);
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&(h->seq), __ATOMIC_RELAXED) == s0 ? 0 : -1;
+}
+
+/* look up k as reader r, the value goes to v */
+int hl_hcget( hlHashShared_t* h, int r, unsigned char* k, int l, void** v ){
+  unsigned hv = hl_hash(k, l);
+  int f;
+  __atomic_store_n(&(h->r[r].e), __atomic_load_n(&(h->epoch), __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST); /* announce before loading h->a */
+  while( (f = hl_hcfind(h, k, l, hv, v)) == -1 );
+  __atomic_store_n(&(h->r[r].e), 0, __ATOMIC_RELEASE);
+  return f;
+}
+
+void hl_hcset( hlHashShared_t* h, unsigned char* k, int l, void* v ){
+  hlHashArr_t* a = h->a;
+  hlHashEl_t n;
+  long i;
+  if( !l ) return;
+  n = hl_hinitnode(k, l, v, hl_hash(k, l));
+  if( (i = hl_hfind(a->t, a->m, a->n, k, l, n.h, NULL)) != -1 ){
+    __atomic_store_n(&(a->t[i].v), v, __ATOMIC_RELEASE); /* one word, no retry needed */
+    return;
+  }
+  if( hl_hgrow(h->c + h->d + 1, a->n) ){
+    if( hl_hpurge(h->d, a->n) ) hl_hcresize(h, a->s);
+    else if( a->s < HL_HMAX ) hl_hcresize(h, a->s + 1);
+    a = h->a;
+  }
+  i = hl_hvacant(a->m, a->n, n.h);
+  if( i == -1 ) return; /* full at the largest size */
+  if( a->m[i] == HL_HDELETED ) h->d--;
+  hl_hcbegin(h);
+  a->t[i] = n;
+  hl_hsetctrl(a->m, a->n, i, hl_htag(n.h));
+  hl_hcend(h);
+  h->c++;
+  if( h->old ) hl_hcreclaim(h);
+}
+
+void hl_hcdel( hlHashShared_t* h, unsigned char* k, int l ){
+  hlHashArr_t* a = h->a;
+  long i = hl_hfind(a->t, a->m, a->n, k, l, hl_hash(k, l), NULL);
+  if( i == -1 ) return;
+  /* the slot keeps its contents, a reader may be comparing a copy */
+  hl_hcbegin(h);
+  hl_hsetctrl(a->m, a->n, i, HL_HDELETED);
+  hl_hcend(h);
+  h->c--;
+  h->d++;
+  if( h->d >= (a->n >> 2) ) hl_hcresize(h, a->s);
+  else if( h->old ) hl_hcreclaim(h);
+}
+
+/* no reader may be inside the table */
+void hl_hcfree( hlHashShared_t* h ){
+  hlHashArr_t* a;
+  while( (a = h->old) ){
+    h->old = a->next;
+    hl_hcrelease(a);
+  }
+  hl_hcrelease(h->a);
+  free(h);
+}
+#endif
+
+/*
+ * end hash table
+ */ 
+
+/*
+ * Arena
+ */
+
+#define hl_around(n) (((n) + 15) & ~15UL)
+
+void* hl_aalloc( hlArena_t* a, unsigned long n ){
+  hlArenaBlock_t* b = a->b;
+  unsigned long off = hl_around(sizeof(hlArenaBlock_t));
+  n = hl_around(n);
+  if( !b || b->used + n > b->n ){
+    unsigned long bn = n > HL_ABLOCK ? n : HL_ABLOCK;
+    if( !(b = malloc(off + bn)) ) return NULL;
+    b->n = bn;
+    b->used = 0;
+    /* an oversized request leaves the current block in front */
+    if( n > HL_ABLOCK && a->b ){
+      b->next = a->b->next;
+      a->b->next = b;
+    } else {
+      b->next = a->b;
+      a->b = b;
+    }
+  }
+  a->bytes += n;
+  b->used += n;
+  return (unsigned char *)b + off + b->used - n;
+}
+
+void hl_afree( hlArena_t* a ){
+  hlArenaBlock_t* b;
+  while( (b = a->b) ){
+    a->b = b->next;
+    free(b);
+  }
+  a->bytes = 0;
+}
+
+/*
+ * end arena
+ */
+
+/*
+ * Ordered Map
+ */
+
+/* node bytes for a height and key length */
+#define hl_msize(h, l) \
+  hl_around(sizeof(hlMapNode_t) + ((h) - 1) * sizeof(hlMapNode_t*) + (l))
+
+static int hl_mkcmp( unsigned char* a, int al, unsigned char* b, int bl ){
+  int c = memcmp(a, b, al < bl ? al : bl);
+  return c ? c : al - bl;
+}
+
+#define hl_mcmp(n, b, bl) hl_mkcmp((n)->k, (n)->l, b, bl)
+
+/* heights with p = 1/4, from an xorshift seeded by the state */
+static int hl_mheight( unsigned long* rnd ){
+  unsigned long r;
+  int h = 1;
+  *rnd ^= *rnd << 13;
+  *rnd ^= *rnd >> 7;
+  *rnd ^= *rnd << 17;
+  for( r = *rnd; (r & 3) == 0 && h < HL_MMAXH; r >>= 2 ) h++;
+  return h;
+}
+
+hlMap_t hl_minit( hlState_t* s ){
+  hlMap_t m;
+  memset(&m, 0, sizeof(hlMap_t));
+  m.state = s;
+  m.r = (s ? s->seed[0] : 0) | 1;
+  m.head = hl_aalloc(&m.a, hl_msize(HL_MMAXH, 0));
+  if( m.head ) memset(m.head, 0, hl_msize(HL_MMAXH, 0));
+  return m;
+}
+
+/* 
+ * the last node before k on every level, the node after u[0] is the 
+ * first one not below k 
+ */
+static void hl_mfind( hlMap_t* m, unsigned char* k, int l, hlMapNode_t** u ){
+  hlMapNode_t* n = m->head;
+  int i;
+  for( i = m->h - 1; i >= 0; i-- ){
+    while( n->next[i] && hl_mcmp(n->next[i], k, l) < 0 )
+      n = n->next[i];
+    u[i] = n;
+  }
+}
+
+void hl_mset( hlMap_t* m, unsigned char* k, int l, void* v ){
+  hlMapNode_t *u[HL_MMAXH], *n;
+  unsigned long sz;
+  int h, i;
+  if( !m->head ) return;
+  hl_mfind(m, k, l, u);
+  n = m->h ? u[0]->next[0] : NULL;
+  if( n && !hl_mcmp(n, k, l) ){
+    n->v = v;
+    return;
+  }
+  h = hl_mheight(&(m->r));
+  for( ; m->h < h; m->h++ ) u[m->h] = m->head;
+  sz = hl_msize(h, l);
+  if( sz / 16 < HL_MFREE && (n = m->free[sz / 16]) ){
+    m->free[sz / 16] = n->next[0];
+  } else if( !(n = hl_aalloc(&m->a, sz)) ){
+    return;
+  }
+  n->k = (unsigned char *)&(n->next[h]);
+  memcpy(n->k, k, l);
+  n->l = l;
+  n->h = h;
+  n->v = v;
+  for( i = 0; i < h; i++ ){
+    n->next[i] = u[i]->next[i];
+    u[i]->next[i] = n;
+  }
+  m->c++;
+}
+
+hlMapNode_t* hl_mget( hlMap_t* m, unsigned char* k, int l ){
+  hlMapNode_t* n = hl_mceil(m, k, l);
+  return n && !hl_mcmp(n, k, l) ? n : NULL;
+}
+
+void hl_mdel( hlMap_t* m, unsigned char* k, int l ){
+  hlMapNode_t *u[HL_MMAXH], *n;
+  unsigned long sz;
+  int i;
+  if( !m->h ) return;
+  hl_mfind(m, k, l, u);
+  n = u[0]->next[0];
+  if( !n || hl_mcmp(n, k, l) ) return;
+  for( i = 0; i < n->h; i++ )
+    u[i]->next[i] = n->next[i];
+  while( m->h && !m->head->next[m->h - 1] ) m->h--;
+  sz = hl_msize(n->h, n->l);
+  if( sz / 16 < HL_MFREE ){
+    n->next[0] = m->free[sz / 16];
+    m->free[sz / 16] = n;
+  }
+  m->c--;
+}
+
+/* the largest key <= k, or NULL */
+hlMapNode_t* hl_mfloor( hlMap_t* m, unsigned char* k, int l ){
+  hlMapNode_t *u[HL_MMAXH], *n;
+  if( !m->h ) return NULL;
+  hl_mfind(m, k, l, u);
+  n = u[0]->next[0];
+  if( n && !hl_mcmp(n, k, l) ) return n;
+  return u[0] == m->head ? NULL : u[0];
+}
+
+/* the smallest key >= k, or NULL */
+hlMapNode_t* hl_mceil( hlMap_t* m, unsigned char* k, int l ){
+  hlMapNode_t* n = m->head;
+  int i;
+  if( !m->h ) return NULL;
+  for( i = m->h - 1; i >= 0; i-- )
+    while( n->next[i] && hl_mcmp(n->next[i], k, l) < 0 )
+      n = n->next[i];
+  return n->next[0];
+}
+
+hlMapRange_t hl_mrange( hlMap_t* m, unsigned char* lo, int ll, unsigned char* hi, int hl ){
+  hlMapRange_t r;
+  r.n = lo ? hl_mceil(m, lo, ll) : (m->h ? hl_mfirst(m) : NULL);
+  r.hi = hi;
+  r.hl = hl;
+  return r;
+}
+
+/* the next node of a range, or NULL once it is done */
+hlMapNode_t* hl_mnext( hlMapRange_t* r ){
+  hlMapNode_t* n = r->n;
+  if( !n || (r->hi && hl_mcmp(n, r->hi, r->hl) >= 0) ) return r->n = NULL;
+  r->n = n->next[0];
+  return n;
+}
+
+void hl_mfree( hlMap_t* m ){
+  hl_afree(&m->a);
+  memset(m, 0, sizeof(hlMap_t));
+}
+
+#ifdef __GNUC__
+#define hl_mcmarked(p) ((unsigned long)(p) & 1)
+#define hl_mcmark(p)   ((hlMapCNode_t *)((unsigned long)(p) | 1))
+#define hl_mcclean(p)  ((hlMapCNode_t *)((unsigned long)(p) & ~1UL))
+#define hl_mcload(p)   __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define hl_mccas(p, o, n) \
+  __atomic_compare_exchange_n(&(p), &(o), n, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+#define hl_mcnsize(h, l) \
+  (sizeof(hlMapCNode_t) + ((h) - 1) * sizeof(hlMapCNode_t*) + (l))
+
+hlMapShared_t* hl_mcinit( hlState_t* s ){
+  hlMapShared_t* m = malloc(sizeof(hlMapShared_t));
+  if( !m ) return NULL;
+  memset(m, 0, sizeof(hlMapShared_t));
+  m->epoch = 1; /* 0 marks a thread outside the map */
+  m->seed = (s ? s->seed[1] : 0) | 1;
+  if( !(m->head = malloc(hl_mcnsize(HL_MMAXH, 0))) ){
+    free(m);
+    return NULL;
+  }
+  memset(m->head, 0, hl_mcnsize(HL_MMAXH, 0));
+  m->head->h = HL_MMAXH;
+  return m;
+}
+
+/* take a thread slot, or -1 if all are taken */
+int hl_mcjoin( hlMapShared_t* m ){
+  unsigned long z;
+  int i;
+  for( i = 0; i < HL_MCTHREADS; i++ ){
+    z = 0;
+    if( __atomic_compare_exchange_n(&(m->t[i].u), &z, 1, 0, 
+          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ){
+      if( !m->t[i].rnd ) m->t[i].rnd = m->seed * (2 * i + 1);
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* the slot's retired nodes stay with it for the next thread to join */
+void hl_mcleave( hlMapShared_t* m, int t ){
+  __atomic_store_n(&(m->t[t].u), 0, __ATOMIC_RELEASE);
+}
+
+/* announce the epoch before touching any node, again if it moved meanwhile */
+static void hl_mcenter( hlMapShared_t* m, int t ){
+  unsigned long e;
+  do {
+    e = __atomic_load_n(&(m->epoch), __ATOMIC_ACQUIRE);
+    __atomic_store_n(&(m->t[t].e), e, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  } while( e != __atomic_load_n(&(m->epoch), __ATOMIC_ACQUIRE) );
+}
+
+static void hl_mcexit( hlMapShared_t* m, int t ){
+  __atomic_store_n(&(m->t[t].e), 0, __ATOMIC_RELEASE);
+}
+
+/* 
+ * advance the epoch if every thread inside has seen it, then free
+ * what was retired two epochs ago, nobody can still hold those
+ */
+static void hl_mcreclaim( hlMapShared_t* m, int t ){
+  unsigned long g = __atomic_load_n(&(m->epoch), __ATOMIC_SEQ_CST), e;
+  hlMapCNode_t **p = &(m->t[t].r), *n;
+  int i;
+  for( i = 0; i < HL_MCTHREADS; i++ ){
+    e = __atomic_load_n(&(m->t[i].e), __ATOMIC_SEQ_CST);
+    if( e && e != g ) break;
+  }
+  if( i == HL_MCTHREADS ) __atomic_compare_exchange_n(&(m->epoch), &g, g + 1, 0, 
+    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  g = __atomic_load_n(&(m->epoch), __ATOMIC_SEQ_CST);
+  while( (n = *p) ){
+    if( n->re + 2 <= g ){
+      *p = n->r;
+      free(n);
+      m->t[t].rc--;
+    } else p = &(n->r);
+  }
+}
+
+/* 
+ * a node is retired once by whichever of its inserter and deleter 
+ * finishes last, each has unlinked it from every level it could 
+ * have linked by then 
+ */
+static void hl_mcdone( hlMapShared_t* m, int t, hlMapCNode_t* n, int f ){
+  if( !(__atomic_fetch_or(&(n->st), f, __ATOMIC_ACQ_REL) & (3 ^ f)) ) return;
+  n->re = __atomic_load_n(&(m->epoch), __ATOMIC_SEQ_CST);
+  n->r = m->t[t].r;
+  m->t[t].r = n;
+  if( ++(m->t[t].rc) >= HL_MCBATCH ) hl_mcreclaim(m, t);
+}
+
+/* 
+ * preds and succs of k on every level, unlinking marked nodes on 
+ * the way. 1 if succs[0] holds k 
+ */
+static int hl_mcfind( 
+  hlMapShared_t* m, unsigned char* k, int l, hlMapCNode_t** preds, hlMapCNode_t** succs 
+){
+  hlMapCNode_t *pred, *curr, *succ;
+  int i;
+retry:
+  pred = m->head;
+  for( i = HL_MMAXH - 1; i >= 0; i-- ){
+    curr = hl_mcclean(hl_mcload(pred->next[i]));
+    while( curr ){
+      succ = hl_mcload(curr->next[i]);
+      if( hl_mcmarked(succ) ){
+        hlMapCNode_t* o = curr;
+        if( !hl_mccas(pred->next[i], o, hl_mcclean(succ)) ) goto retry;
+        curr = hl_mcclean(succ);
+        continue;
+      }
+      if( hl_mcmp(curr, k, l) >= 0 ) break;
+      pred = curr;
+      curr = succ;
+    }
+    preds[i] = pred;
+    succs[i] = curr;
+  }
+  return succs[0] && !hl_mcmp(succs[0], k, l);
+}
+
+/* the first unmarked node >= k, without helping unlink */
+static hlMapCNode_t* hl_mcceil( hlMapShared_t* m, unsigned char* k, int l ){
+  hlMapCNode_t *pred = m->head, *curr, *succ;
+  int i;
+  for( i = HL_MMAXH - 1; i >= 0; i-- ){
+    curr = hl_mcclean(hl_mcload(pred->next[i]));
+    while( curr ){
+      succ = hl_mcload(curr->next[i]);
+      if( hl_mcmarked(succ) ){
+        curr = hl_mcclean(succ);
+        continue;
+      }
+      if( hl_mcmp(curr, k, l) >= 0 ) break;
+      pred = curr;
+      curr = succ;
+    }
+  }
+  return curr;
+}
+
+/* look up k as thread t, the value goes to v */
+int hl_mcget( hlMapShared_t* m, int t, unsigned char* k, int l, void** v ){
+  hlMapCNode_t* n;
+  int f;
+  hl_mcenter(m, t);
+  n = hl_mcceil(m, k, l);
+  if( (f = n && !hl_mcmp(n, k, l)) ) *v = __atomic_load_n(&(n->v), __ATOMIC_ACQUIRE);
+  hl_mcexit(m, t);
+  return f;
+}
+
+void hl_mcset( hlMapShared_t* m, int t, unsigned char* k, int l, void* v ){
+  hlMapCNode_t *preds[HL_MMAXH], *succs[HL_MMAXH], *n = NULL, *o;
+  int h = hl_mheight(&(m->t[t].rnd)), i;
+  hl_mcenter(m, t);
+  for( ;; ){
+    if( hl_mcfind(m, k, l, preds, succs) ){
+      __atomic_store_n(&(succs[0]->v), v, __ATOMIC_RELEASE);
+      free(n); /* never published */
+      hl_mcexit(m, t);
+      return;
+    }
+    if( !n ){
+      if( !(n = malloc(hl_mcnsize(h, l))) ) break;
+      n->k = (unsigned char *)&(n->next[h]);
+      memcpy(n->k, k, l);
+      n->l = l;
+      n->h = h;
+      n->v = v;
+      n->st = 0;
+    }
+    for( i = 0; i < h; i++ ) n->next[i] = succs[i];
+    o = succs[0];
+    if( hl_mccas(preds[0]->next[0], o, n) ) break;
+  }
+  /* linked at level 0, now the upper levels until done or deleted */
+  for( i = 1; n && i < h; i++ ){
+    for( ;; ){
+      o = hl_mcload(n->next[i]);
+      if( hl_mcmarked(o) ) goto linked;
+      if( o != succs[i] && !hl_mccas(n->next[i], o, succs[i]) ) continue;
+      o = succs[i];
+      if( hl_mccas(preds[i]->next[i], o, n) ) break;
+      hl_mcfind(m, k, l, preds, succs);
+      if( succs[0] != n ) goto linked; /* deleted meanwhile */
+    }
+  }
+linked:
+  if( n ){
+    if( hl_mcmarked(hl_mcload(n->next[0])) ) hl_mcfind(m, k, l, preds, succs);
+    hl_mcdone(m, t, n, 1);
+  }
+  hl_mcexit(m, t);
+}
+
+/* 1 if this call deleted k */
+int hl_mcdel( hlMapShared_t* m, int t, unsigned char* k, int l ){
+  hlMapCNode_t *preds[HL_MMAXH], *succs[HL_MMAXH], *n, *o;
+  int i;
+  hl_mcenter(m, t);
+  if( !hl_mcfind(m, k, l, preds, succs) ){
+    hl_mcexit(m, t);
+    return 0;
+  }
+  n = succs[0];
+  for( i = n->h - 1; i > 0; i-- ){
+    do o = hl_mcload(n->next[i]);
+    while( !hl_mcmarked(o) && !hl_mccas(n->next[i], o, hl_mcmark(o)) );
+  }
+  for( ;; ){
+    o = hl_mcload(n->next[0]);
+    if( hl_mcmarked(o) ){ /* another delete won */
+      hl_mcexit(m, t);
+      return 0;
+    }
+    if( hl_mccas(n->next[0], o, hl_mcmark(o)) ) break;
+  }
+  hl_mcfind(m, k, l, preds, succs);
+  hl_mcdone(m, t, n, 2);
+  hl_mcexit(m, t);
+  return 1;
+}
+
+/* call fn for every key in [lo, hi), fn must not use the map */
+void hl_mcscan( 
+  hlMapShared_t* m, int t, unsigned char* lo, int ll, unsigned char* hi, int hl, 
+  void (*fn)( void*, unsigned char*, int, void* ), void* c 
+){
+  hlMapCNode_t *n, *succ;
+  hl_mcenter(m, t);
+  n = lo ? hl_mcceil(m, lo, ll) : hl_mcclean(hl_mcload(m->head->next[0]));
+  for( ; n && (!hi || hl_mcmp(n, hi, hl) < 0); n = hl_mcclean(succ) ){
+    succ = hl_mcload(n->next[0]);
+    if( !hl_mcmarked(succ) ) fn(c, n->k, n->l, __atomic_load_n(&(n->v), __ATOMIC_ACQUIRE));
+  }
+  hl_mcexit(m, t);
+}
+
+/* no thread may be inside the map */
+void hl_mcfree( hlMapShared_t* m ){
+  hlMapCNode_t *n, *next;
+  int i;
+  for( n = hl_mcclean(m->head->next[0]); n; n = next ){
+    next = hl_mcclean(n->next[0]);
+    free(n);
+  }
+  for( i = 0; i < HL_MCTHREADS; i++ ){
+    for( n = m->t[i].r; n; n = next ){
+      next = n->r;
+      free(n);
+    }
+  }
+  free(m->head);
+  free(m);
+}
+#endif
+
+/*
+ * end ordered map
+ */
+ 
+/*
+ * Parser
+ */
+
+typedef enum {
+  tk_oeq,    tk_meq,    tk_peq,    tk_teq,     tk_xeq,    tk_deq,    
+  tk_modeq,  tk_rseq,   tk_lseq,   tk_aeq,     tk_leq,    tk_geq,        
+  tk_ls,     tk_rs,     tk_esc,    tk_lbrc,   
+  tk_rbrc,   tk_lbrk,   tk_rbrk,   tk_col,     tk_lp,     tk_rp,     
+  tk_sem,    tk_com,    tk_dcol,   tk_spr,     tk_per,    tk_arrow,  
+  tk_not,    tk_lnot,   tk_ast,    tk_bor,     tk_sub,    tk_add,    
+  tk_xor,    tk_div,    tk_mod,    tk_gt,      tk_lt,     tk_band,   
+  tk_iseq,   tk_neq,    tk_eq,     tk_let,     tk_if,     tk_else,   tk_return, 
+  tk_while,  tk_fn,     tk_true,   tk_false,   tk_nil,    tk_for,    
+  tk_in,     tk_break,  tk_land,   tk_lor,     tk_str,    tk_num,     
+  tk_array,  tk_new, tk_bool,   tk_function, tk_Nil,   tk_log, /* temporary */
+  tk_struct, tk_use, tk_string,  tk_number, tk_boolean,
+  tk_name,   tk_eof
+} token;
+
+static const int tkSymCnt = 43;
+
+static const char* hlTkns[] = {
+  "|=", "-=", "+=", "*=", "^=", "/=", "%=", ">>=",
+  "<<=", "&=", "<=", ">=", "<<", ">>",
+  "\\", "{", "}", "[", "]", ":", "(", ")", ";", ",",
+  "::", "..", ".", "->", "!", "~", "*", "|", "-",
+  "+", "^", "/", "%", ">", "<", "&", "==", "!=", "=", "let",
   "if", "else", "return", "while", "fn", "true",
   "false", "nil", "for", "in", "break", "and", "or",
   "String", "Number", "Array", "new",
@@ -346,205 +1822,1567 @@ static const char* hlTkns[] = {
 #define hl_isalpha(x)       (hl_islower(x) || hl_isupper(x))
 #define hl_ishex(x)         (x >= 'a' && x <= 'f')
 
+/*
+ * Symbols are matched by a DFA over their bytes, built from hlTkns 
+ * by hl_linit. State 0 dispatches on the first byte, the longest 
+ * symbol wins
+ */
+#define HL_LSTATES 64
+
+static unsigned char hlLexNext[HL_LSTATES][128]; /* 0, no edge */
+static signed char   hlLexTok[HL_LSTATES]; /* symbol accepted, -1 none */
+
+static void hl_linit( void ){
+  static int built = 0;
+  int i, j, st, n = 1;
+  if( built ) return;
+  memset(hlLexTok, -1, sizeof(hlLexTok));
+  for( i = 0; i < tkSymCnt; i++ ){
+    for( st = 0, j = 0; hlTkns[i][j]; j++ ){
+      unsigned char c = hlTkns[i][j];
+      if( !hlLexNext[st][c] ) hlLexNext[st][c] = n++;
+      st = hlLexNext[st][c];
+    }
+    hlLexTok[st] = i;
+  }
+  built = 1;
+  hl_lsimd(32);
+}
+
+/*
+ * Scanners for runs of whitespace, comments and string literals. 
+ * hl_lscan returns the first index from x whose byte is (in != 0) or
+ * is not (in == 0) one of the 4 in c, or n. The widest one the CPU
+ * supports is picked at runtime
+ */
+static int hl_lscan1( unsigned char* p, int x, int n, const unsigned char* c, int in ){
+  for( ; x < n; x++ )
+    if( (p[x] == c[0] || p[x] == c[1] || p[x] == c[2] || p[x] == c[3]) == in ) break;
+  return x;
+}
+
+#ifdef __SSE2__
+static int hl_lscan16( unsigned char* p, int x, int n, const unsigned char* c, int in ){
+  __m128i c0 = _mm_set1_epi8((char)c[0]), c1 = _mm_set1_epi8((char)c[1]);
+  __m128i c2 = _mm_set1_epi8((char)c[2]), c3 = _mm_set1_epi8((char)c[3]), v;
+  unsigned m;
+  for( ; x + 16 <= n; x += 16 ){
+    v = _mm_loadu_si128((const __m128i *)(p + x));
+    m = _mm_movemask_epi8(_mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, c0), _mm_cmpeq_epi8(v, c1)),
+      _mm_or_si128(_mm_cmpeq_epi8(v, c2), _mm_cmpeq_epi8(v, c3))
+    ));
+    if( !in ) m ^= 0xffff;
+    if( m ) return x + hl_hctz(m);
+  }
+  return hl_lscan1(p, x, n, c, in);
+}
+#endif
+
+#ifdef HL_LAVX2
+__attribute__((target("avx2")))
+static int hl_lscan32( unsigned char* p, int x, int n, const unsigned char* c, int in ){
+  __m256i c0 = _mm256_set1_epi8((char)c[0]), c1 = _mm256_set1_epi8((char)c[1]);
+  __m256i c2 = _mm256_set1_epi8((char)c[2]), c3 = _mm256_set1_epi8((char)c[3]), v;
+  unsigned m;
+  for( ; x + 32 <= n; x += 32 ){
+    v = _mm256_loadu_si256((const __m256i *)(p + x));
+    m = _mm256_movemask_epi8(_mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, c0), _mm256_cmpeq_epi8(v, c1)),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, c2), _mm256_cmpeq_epi8(v, c3))
+    ));
+    if( !in ) m = ~m;
+    if( m ) return x + hl_hctz(m);
+  }
+  return hl_lscan16(p, x, n, c, in);
+}
+#endif
+
+static int (*hl_lscan)( unsigned char*, int, int, const unsigned char*, int ) = hl_lscan1;
+
+/* 
+ * pick the widest scanner up to w bytes the CPU has, w < 0 only 
+ * asks. Returns its width, 1 is the scalar loop 
+ */
+int hl_lsimd( int w ){
+  if( w < 0 ){
+#ifdef HL_LAVX2
+    if( hl_lscan == hl_lscan32 ) return 32;
+#endif
+#ifdef __SSE2__
+    if( hl_lscan == hl_lscan16 ) return 16;
+#endif
+    return 1;
+  }
+#ifdef HL_LAVX2
+  __builtin_cpu_init();
+  if( w >= 32 && __builtin_cpu_supports("avx2") ){
+    hl_lscan = hl_lscan32;
+    return 32;
+  }
+#endif
+#ifdef __SSE2__
+  if( w >= 16 ){
+    hl_lscan = hl_lscan16;
+    return 16;
+  }
+#endif
+  hl_lscan = hl_lscan1;
+  return 1;
+}
+
+static const unsigned char hlLexSpace[4] = { ' ', '\t', '\n', '\r' };
+static const unsigned char hlLexLine[4] = { '\n', '\r', '\n', '\r' };
+static const unsigned char hlLexDash[4] = { '-', '-', '-', '-' };
+static const unsigned char hlLexDq[4] = { '"', '\\', '"', '\\' };
+static const unsigned char hlLexSq[4] = { '\'', '\\', '\'', '\\' };
+
+/* 
+ * Keywords hash perfectly on their first and last bytes and length,
+ * regenerate the table when one is added
+ */
+#define hl_lkwhash(p, l) (((p)[0] * 3 + (p)[(l) - 1] * 19 + (l)) & 63)
+
+static const signed char hlLexKw[64] = {
+  -1,          -1,     -1,        tk_array,  tk_function, tk_lor,   tk_return, -1,
+  -1,          -1,     -1,        -1,        -1,          -1,       -1,        tk_if,
+  -1,          tk_nil, tk_land,   -1,        -1,          -1,       -1,        -1,
+  -1,          -1,     -1,        -1,        tk_break,    -1,       tk_fn,     tk_true,
+  -1,          tk_use, tk_new,    tk_let,    tk_str,      -1,       tk_num,    tk_in,
+  -1,          tk_while, -1,      tk_for,    tk_log,      -1,       -1,        -1,
+  -1,          tk_Nil, tk_else,   -1,        -1,          -1,       tk_false,  tk_bool,
+  -1,          -1,     -1,        tk_struct, -1,          -1,       -1,        -1
+};
+
 #define hl_hextod(x) do { \
   if( hl_isdigit(x) ) x = x - '0'; \
   else if( hl_ishex(x) ) x = 10 + (x - 'a'); \
 } while( 0 )
 
-static unsigned char pesc( unsigned char* p, int* i ){
-  unsigned char c = *p;
-  switch( c ){
-    case 'a': c = '\a'; break;
-    case 'b': c = '\b'; break;
-    case 'f': c = '\f'; break;
-    case 'n': c = '\n'; break;
-    case 'r': c = '\r'; break;
-    case 't': c = '\t'; break;
-    case 'v': c = '\v'; break;
-    case 'x': {
-      unsigned char l = *(p + 1);
-      unsigned char r = *(p + 2);
-      hl_hextod(l);
-      hl_hextod(r);
-      c = (l << 4) | r;
-      (*i) += 2; 
-    } break;
-    default: c = 0; break;
+/* the byte escaped at p, at most e - p bytes are read */
+static unsigned char pesc( unsigned char* p, unsigned char* e, int* i ){
+  unsigned char c = p < e ? *p : 0;
+  switch( c ){
+    case 'a': c = '\a'; break;
+    case 'b': c = '\b'; break;
+    case 'f': c = '\f'; break;
+    case 'n': c = '\n'; break;
+    case 'r': c = '\r'; break;
+    case 't': c = '\t'; break;
+    case 'v': c = '\v'; break;
+    case 'x': {
+      unsigned char l = p + 1 < e ? *(p + 1) : 0;
+      unsigned char r = p + 2 < e ? *(p + 2) : 0;
+      hl_hextod(l);
+      hl_hextod(r);
+      c = (l << 4) | r;
+      (*i) += 2; 
+    } break;
+    default: c = 0; break;
+  }
+  (*i)++;
+  return c;
+}
+
+/* 
+ * the id of the interned copy of k, made the first time k is seen.
+ * Ids are stable and index s->strs 
+ */
+int hl_intern( hlState_t* s, unsigned char* k, int l ){
+  hlString_t* str;
+  int i;
+  hl_eabortr(s, 0);
+  if( s->sc && !l ) return 0; /* tables hold no empty keys */
+  if( (i = hl_hget(&s->names, k, l)) != -1 ) return (int)(long)hl_hval(&s->names, i);
+  if( s->sc == s->ss ){
+    int n = s->ss ? 2 * s->ss : 64;
+    hlString_t** b = realloc(s->strs, n * sizeof(hlString_t*));
+    if( !b ){
+      hl_error(s, "malloc failure\n", NULL);
+      return 0;
+    }
+    s->strs = b;
+    s->ss = n;
+  }
+  if( !(str = hl_aalloc(&s->sa, sizeof(hlString_t) + l + 1)) ){
+    hl_error(s, "malloc failure\n", NULL);
+    return 0;
+  }
+  str->data = (unsigned char *)(str + 1);
+  memcpy(str->data, k, l);
+  str->data[l] = 0;
+  str->l = l;
+  s->strs[s->sc] = str;
+  hl_hset(&s->names, str->data, l, (void *)(long)s->sc);
+  return s->sc++;
+}
+
+/* intern the l bytes of a string literal with its escapes replaced */
+static int pstring( hlState_t* s, unsigned char* v, int l ){
+  int i = 0, j = 0, id;
+  unsigned char c, e;
+  unsigned char* b = hl_malloc(s, l + 1);
+  if( !b ) return 0;
+  while( i < l ){
+    c = v[i++];
+    if( c == '\\' ){
+      e = pesc(v + i, v + l, &i);
+      if( e ) b[j++] = e;
+    } else {
+      b[j++] = c;
+    }
+  }
+  id = hl_intern(s, b, j);
+  free(b);
+  return id;
+}
+
+/*
+ * Numbers are read exactly. Decimal significands of up to 19 digits
+ * take Clinger's fast path when both they and the power of ten fit a
+ * double, else Eisel-Lemire; longer ones go through strtod. Hex
+ * literals are integers, rounded once if they pass 2^53
+ */
+#define HL_NMINQ -342 /* smaller powers of ten always round to 0 */
+#define HL_NMAXQ 308
+
+/* 
+ * 5^q normalized to 128 bits, high word first, for q from HL_NMINQ to 
+ * HL_NMAXQ. Truncated for q >= 0, rounded up for q < 0 
+ */
+static const unsigned long hlPow5[] = {
+  0xeef453d6923bd65aUL, 0x113faa2906a13b3fUL,
+  0x9558b4661b6565f8UL, 0x4ac7ca59a424c507UL,
+  0xbaaee17fa23ebf76UL, 0x5d79bcf00d2df649UL,
+  0xe95a99df8ace6f53UL, 0xf4d82c2c107973dcUL,
+  0x91d8a02bb6c10594UL, 0x79071b9b8a4be869UL,
+  0xb64ec836a47146f9UL, 0x9748e2826cdee284UL,
+  0xe3e27a444d8d98b7UL, 0xfd1b1b2308169b25UL,
+  0x8e6d8c6ab0787f72UL, 0xfe30f0f5e50e20f7UL,
+  0xb208ef855c969f4fUL, 0xbdbd2d335e51a935UL,
+  0xde8b2b66b3bc4723UL, 0xad2c788035e61382UL,
+  0x8b16fb203055ac76UL, 0x4c3bcb5021afcc31UL,
+  0xaddcb9e83c6b1793UL, 0xdf4abe242a1bbf3dUL,
+  0xd953e8624b85dd78UL, 0xd71d6dad34a2af0dUL,
+  0x87d4713d6f33aa6bUL, 0x8672648c40e5ad68UL,
+  0xa9c98d8ccb009506UL, 0x680efdaf511f18c2UL,
+  0xd43bf0effdc0ba48UL, 0x0212bd1b2566def2UL,
+  0x84a57695fe98746dUL, 0x014bb630f7604b57UL,
+  0xa5ced43b7e3e9188UL, 0x419ea3bd35385e2dUL,
+  0xcf42894a5dce35eaUL, 0x52064cac828675b9UL,
+  0x818995ce7aa0e1b2UL, 0x7343efebd1940993UL,
+  0xa1ebfb4219491a1fUL, 0x1014ebe6c5f90bf8UL,
+  0xca66fa129f9b60a6UL, 0xd41a26e077774ef6UL,
+  0xfd00b897478238d0UL, 0x8920b098955522b4UL,
+  0x9e20735e8cb16382UL, 0x55b46e5f5d5535b0UL,
+  0xc5a890362fddbc62UL, 0xeb2189f734aa831dUL,
+  0xf712b443bbd52b7bUL, 0xa5e9ec7501d523e4UL,
+  0x9a6bb0aa55653b2dUL, 0x47b233c92125366eUL,
+  0xc1069cd4eabe89f8UL, 0x999ec0bb696e840aUL,
+  0xf148440a256e2c76UL, 0xc00670ea43ca250dUL,
+  0x96cd2a865764dbcaUL, 0x380406926a5e5728UL,
+  0xbc807527ed3e12bcUL, 0xc605083704f5ecf2UL,
+  0xeba09271e88d976bUL, 0xf7864a44c633682eUL,
+  0x93445b8731587ea3UL, 0x7ab3ee6afbe0211dUL,
+  0xb8157268fdae9e4cUL, 0x5960ea05bad82964UL,
+  0xe61acf033d1a45dfUL, 0x6fb92487298e33bdUL,
+  0x8fd0c16206306babUL, 0xa5d3b6d479f8e056UL,
+  0xb3c4f1ba87bc8696UL, 0x8f48a4899877186cUL,
+  0xe0b62e2929aba83cUL, 0x331acdabfe94de87UL,
+  0x8c71dcd9ba0b4925UL, 0x9ff0c08b7f1d0b14UL,
+  0xaf8e5410288e1b6fUL, 0x07ecf0ae5ee44dd9UL,
+  0xdb71e91432b1a24aUL, 0xc9e82cd9f69d6150UL,
+  0x892731ac9faf056eUL, 0xbe311c083a225cd2UL,
+  0xab70fe17c79ac6caUL, 0x6dbd630a48aaf406UL,
+  0xd64d3d9db981787dUL, 0x092cbbccdad5b108UL,
+  0x85f0468293f0eb4eUL, 0x25bbf56008c58ea5UL,
+  0xa76c582338ed2621UL, 0xaf2af2b80af6f24eUL,
+  0xd1476e2c07286faaUL, 0x1af5af660db4aee1UL,
+  0x82cca4db847945caUL, 0x50d98d9fc890ed4dUL,
+  0xa37fce126597973cUL, 0xe50ff107bab528a0UL,
+  0xcc5fc196fefd7d0cUL, 0x1e53ed49a96272c8UL,
+  0xff77b1fcbebcdc4fUL, 0x25e8e89c13bb0f7aUL,
+  0x9faacf3df73609b1UL, 0x77b191618c54e9acUL,
+  0xc795830d75038c1dUL, 0xd59df5b9ef6a2417UL,
+  0xf97ae3d0d2446f25UL, 0x4b0573286b44ad1dUL,
+  0x9becce62836ac577UL, 0x4ee367f9430aec32UL,
+  0xc2e801fb244576d5UL, 0x229c41f793cda73fUL,
+  0xf3a20279ed56d48aUL, 0x6b43527578c1110fUL,
+  0x9845418c345644d6UL, 0x830a13896b78aaa9UL,
+  0xbe5691ef416bd60cUL, 0x23cc986bc656d553UL,
+  0xedec366b11c6cb8fUL, 0x2cbfbe86b7ec8aa8UL,
+  0x94b3a202eb1c3f39UL, 0x7bf7d71432f3d6a9UL,
+  0xb9e08a83a5e34f07UL, 0xdaf5ccd93fb0cc53UL,
+  0xe858ad248f5c22c9UL, 0xd1b3400f8f9cff68UL,
+  0x91376c36d99995beUL, 0x23100809b9c21fa1UL,
+  0xb58547448ffffb2dUL, 0xabd40a0c2832a78aUL,
+  0xe2e69915b3fff9f9UL, 0x16c90c8f323f516cUL,
+  0x8dd01fad907ffc3bUL, 0xae3da7d97f6792e3UL,
+  0xb1442798f49ffb4aUL, 0x99cd11cfdf41779cUL,
+  0xdd95317f31c7fa1dUL, 0x40405643d711d583UL,
+  0x8a7d3eef7f1cfc52UL, 0x482835ea666b2572UL,
+  0xad1c8eab5ee43b66UL, 0xda3243650005eecfUL,
+  0xd863b256369d4a40UL, 0x90bed43e40076a82UL,
+  0x873e4f75e2224e68UL, 0x5a7744a6e804a291UL,
+  0xa90de3535aaae202UL, 0x711515d0a205cb36UL,
+  0xd3515c2831559a83UL, 0x0d5a5b44ca873e03UL,
+  0x8412d9991ed58091UL, 0xe858790afe9486c2UL,
+  0xa5178fff668ae0b6UL, 0x626e974dbe39a872UL,
+  0xce5d73ff402d98e3UL, 0xfb0a3d212dc8128fUL,
+  0x80fa687f881c7f8eUL, 0x7ce66634bc9d0b99UL,
+  0xa139029f6a239f72UL, 0x1c1fffc1ebc44e80UL,
+  0xc987434744ac874eUL, 0xa327ffb266b56220UL,
+  0xfbe9141915d7a922UL, 0x4bf1ff9f0062baa8UL,
+  0x9d71ac8fada6c9b5UL, 0x6f773fc3603db4a9UL,
+  0xc4ce17b399107c22UL, 0xcb550fb4384d21d3UL,
+  0xf6019da07f549b2bUL, 0x7e2a53a146606a48UL,
+  0x99c102844f94e0fbUL, 0x2eda7444cbfc426dUL,
+  0xc0314325637a1939UL, 0xfa911155fefb5308UL,
+  0xf03d93eebc589f88UL, 0x793555ab7eba27caUL,
+  0x96267c7535b763b5UL, 0x4bc1558b2f3458deUL,
+  0xbbb01b9283253ca2UL, 0x9eb1aaedfb016f16UL,
+  0xea9c227723ee8bcbUL, 0x465e15a979c1cadcUL,
+  0x92a1958a7675175fUL, 0x0bfacd89ec191ec9UL,
+  0xb749faed14125d36UL, 0xcef980ec671f667bUL,
+  0xe51c79a85916f484UL, 0x82b7e12780e7401aUL,
+  0x8f31cc0937ae58d2UL, 0xd1b2ecb8b0908810UL,
+  0xb2fe3f0b8599ef07UL, 0x861fa7e6dcb4aa15UL,
+  0xdfbdcece67006ac9UL, 0x67a791e093e1d49aUL,
+  0x8bd6a141006042bdUL, 0xe0c8bb2c5c6d24e0UL,
+  0xaecc49914078536dUL, 0x58fae9f773886e18UL,
+  0xda7f5bf590966848UL, 0xaf39a475506a899eUL,
+  0x888f99797a5e012dUL, 0x6d8406c952429603UL,
+  0xaab37fd7d8f58178UL, 0xc8e5087ba6d33b83UL,
+  0xd5605fcdcf32e1d6UL, 0xfb1e4a9a90880a64UL,
+  0x855c3be0a17fcd26UL, 0x5cf2eea09a55067fUL,
+  0xa6b34ad8c9dfc06fUL, 0xf42faa48c0ea481eUL,
+  0xd0601d8efc57b08bUL, 0xf13b94daf124da26UL,
+  0x823c12795db6ce57UL, 0x76c53d08d6b70858UL,
+  0xa2cb1717b52481edUL, 0x54768c4b0c64ca6eUL,
+  0xcb7ddcdda26da268UL, 0xa9942f5dcf7dfd09UL,
+  0xfe5d54150b090b02UL, 0xd3f93b35435d7c4cUL,
+  0x9efa548d26e5a6e1UL, 0xc47bc5014a1a6dafUL,
+  0xc6b8e9b0709f109aUL, 0x359ab6419ca1091bUL,
+  0xf867241c8cc6d4c0UL, 0xc30163d203c94b62UL,
+  0x9b407691d7fc44f8UL, 0x79e0de63425dcf1dUL,
+  0xc21094364dfb5636UL, 0x985915fc12f542e4UL,
+  0xf294b943e17a2bc4UL, 0x3e6f5b7b17b2939dUL,
+  0x979cf3ca6cec5b5aUL, 0xa705992ceecf9c42UL,
+  0xbd8430bd08277231UL, 0x50c6ff782a838353UL,
+  0xece53cec4a314ebdUL, 0xa4f8bf5635246428UL,
+  0x940f4613ae5ed136UL, 0x871b7795e136be99UL,
+  0xb913179899f68584UL, 0x28e2557b59846e3fUL,
+  0xe757dd7ec07426e5UL, 0x331aeada2fe589cfUL,
+  0x9096ea6f3848984fUL, 0x3ff0d2c85def7621UL,
+  0xb4bca50b065abe63UL, 0x0fed077a756b53a9UL,
+  0xe1ebce4dc7f16dfbUL, 0xd3e8495912c62894UL,
+  0x8d3360f09cf6e4bdUL, 0x64712dd7abbbd95cUL,
+  0xb080392cc4349decUL, 0xbd8d794d96aacfb3UL,
+  0xdca04777f541c567UL, 0xecf0d7a0fc5583a0UL,
+  0x89e42caaf9491b60UL, 0xf41686c49db57244UL,
+  0xac5d37d5b79b6239UL, 0x311c2875c522ced5UL,
+  0xd77485cb25823ac7UL, 0x7d633293366b828bUL,
+  0x86a8d39ef77164bcUL, 0xae5dff9c02033197UL,
+  0xa8530886b54dbdebUL, 0xd9f57f830283fdfcUL,
+  0xd267caa862a12d66UL, 0xd072df63c324fd7bUL,
+  0x8380dea93da4bc60UL, 0x4247cb9e59f71e6dUL,
+  0xa46116538d0deb78UL, 0x52d9be85f074e608UL,
+  0xcd795be870516656UL, 0x67902e276c921f8bUL,
+  0x806bd9714632dff6UL, 0x00ba1cd8a3db53b6UL,
+  0xa086cfcd97bf97f3UL, 0x80e8a40eccd228a4UL,
+  0xc8a883c0fdaf7df0UL, 0x6122cd128006b2cdUL,
+  0xfad2a4b13d1b5d6cUL, 0x796b805720085f81UL,
+  0x9cc3a6eec6311a63UL, 0xcbe3303674053bb0UL,
+  0xc3f490aa77bd60fcUL, 0xbedbfc4411068a9cUL,
+  0xf4f1b4d515acb93bUL, 0xee92fb5515482d44UL,
+  0x991711052d8bf3c5UL, 0x751bdd152d4d1c4aUL,
+  0xbf5cd54678eef0b6UL, 0xd262d45a78a0635dUL,
+  0xef340a98172aace4UL, 0x86fb897116c87c34UL,
+  0x9580869f0e7aac0eUL, 0xd45d35e6ae3d4da0UL,
+  0xbae0a846d2195712UL, 0x8974836059cca109UL,
+  0xe998d258869facd7UL, 0x2bd1a438703fc94bUL,
+  0x91ff83775423cc06UL, 0x7b6306a34627ddcfUL,
+  0xb67f6455292cbf08UL, 0x1a3bc84c17b1d542UL,
+  0xe41f3d6a7377eecaUL, 0x20caba5f1d9e4a93UL,
+  0x8e938662882af53eUL, 0x547eb47b7282ee9cUL,
+  0xb23867fb2a35b28dUL, 0xe99e619a4f23aa43UL,
+  0xdec681f9f4c31f31UL, 0x6405fa00e2ec94d4UL,
+  0x8b3c113c38f9f37eUL, 0xde83bc408dd3dd04UL,
+  0xae0b158b4738705eUL, 0x9624ab50b148d445UL,
+  0xd98ddaee19068c76UL, 0x3badd624dd9b0957UL,
+  0x87f8a8d4cfa417c9UL, 0xe54ca5d70a80e5d6UL,
+  0xa9f6d30a038d1dbcUL, 0x5e9fcf4ccd211f4cUL,
+  0xd47487cc8470652bUL, 0x7647c3200069671fUL,
+  0x84c8d4dfd2c63f3bUL, 0x29ecd9f40041e073UL,
+  0xa5fb0a17c777cf09UL, 0xf468107100525890UL,
+  0xcf79cc9db955c2ccUL, 0x7182148d4066eeb4UL,
+  0x81ac1fe293d599bfUL, 0xc6f14cd848405530UL,
+  0xa21727db38cb002fUL, 0xb8ada00e5a506a7cUL,
+  0xca9cf1d206fdc03bUL, 0xa6d90811f0e4851cUL,
+  0xfd442e4688bd304aUL, 0x908f4a166d1da663UL,
+  0x9e4a9cec15763e2eUL, 0x9a598e4e043287feUL,
+  0xc5dd44271ad3cdbaUL, 0x40eff1e1853f29fdUL,
+  0xf7549530e188c128UL, 0xd12bee59e68ef47cUL,
+  0x9a94dd3e8cf578b9UL, 0x82bb74f8301958ceUL,
+  0xc13a148e3032d6e7UL, 0xe36a52363c1faf01UL,
+  0xf18899b1bc3f8ca1UL, 0xdc44e6c3cb279ac1UL,
+  0x96f5600f15a7b7e5UL, 0x29ab103a5ef8c0b9UL,
+  0xbcb2b812db11a5deUL, 0x7415d448f6b6f0e7UL,
+  0xebdf661791d60f56UL, 0x111b495b3464ad21UL,
+  0x936b9fcebb25c995UL, 0xcab10dd900beec34UL,
+  0xb84687c269ef3bfbUL, 0x3d5d514f40eea742UL,
+  0xe65829b3046b0afaUL, 0x0cb4a5a3112a5112UL,
+  0x8ff71a0fe2c2e6dcUL, 0x47f0e785eaba72abUL,
+  0xb3f4e093db73a093UL, 0x59ed216765690f56UL,
+  0xe0f218b8d25088b8UL, 0x306869c13ec3532cUL,
+  0x8c974f7383725573UL, 0x1e414218c73a13fbUL,
+  0xafbd2350644eeacfUL, 0xe5d1929ef90898faUL,
+  0xdbac6c247d62a583UL, 0xdf45f746b74abf39UL,
+  0x894bc396ce5da772UL, 0x6b8bba8c328eb783UL,
+  0xab9eb47c81f5114fUL, 0x066ea92f3f326564UL,
+  0xd686619ba27255a2UL, 0xc80a537b0efefebdUL,
+  0x8613fd0145877585UL, 0xbd06742ce95f5f36UL,
+  0xa798fc4196e952e7UL, 0x2c48113823b73704UL,
+  0xd17f3b51fca3a7a0UL, 0xf75a15862ca504c5UL,
+  0x82ef85133de648c4UL, 0x9a984d73dbe722fbUL,
+  0xa3ab66580d5fdaf5UL, 0xc13e60d0d2e0ebbaUL,
+  0xcc963fee10b7d1b3UL, 0x318df905079926a8UL,
+  0xffbbcfe994e5c61fUL, 0xfdf17746497f7052UL,
+  0x9fd561f1fd0f9bd3UL, 0xfeb6ea8bedefa633UL,
+  0xc7caba6e7c5382c8UL, 0xfe64a52ee96b8fc0UL,
+  0xf9bd690a1b68637bUL, 0x3dfdce7aa3c673b0UL,
+  0x9c1661a651213e2dUL, 0x06bea10ca65c084eUL,
+  0xc31bfa0fe5698db8UL, 0x486e494fcff30a62UL,
+  0xf3e2f893dec3f126UL, 0x5a89dba3c3efccfaUL,
+  0x986ddb5c6b3a76b7UL, 0xf89629465a75e01cUL,
+  0xbe89523386091465UL, 0xf6bbb397f1135823UL,
+  0xee2ba6c0678b597fUL, 0x746aa07ded582e2cUL,
+  0x94db483840b717efUL, 0xa8c2a44eb4571cdcUL,
+  0xba121a4650e4ddebUL, 0x92f34d62616ce413UL,
+  0xe896a0d7e51e1566UL, 0x77b020baf9c81d17UL,
+  0x915e2486ef32cd60UL, 0x0ace1474dc1d122eUL,
+  0xb5b5ada8aaff80b8UL, 0x0d819992132456baUL,
+  0xe3231912d5bf60e6UL, 0x10e1fff697ed6c69UL,
+  0x8df5efabc5979c8fUL, 0xca8d3ffa1ef463c1UL,
+  0xb1736b96b6fd83b3UL, 0xbd308ff8a6b17cb2UL,
+  0xddd0467c64bce4a0UL, 0xac7cb3f6d05ddbdeUL,
+  0x8aa22c0dbef60ee4UL, 0x6bcdf07a423aa96bUL,
+  0xad4ab7112eb3929dUL, 0x86c16c98d2c953c6UL,
+  0xd89d64d57a607744UL, 0xe871c7bf077ba8b7UL,
+  0x87625f056c7c4a8bUL, 0x11471cd764ad4972UL,
+  0xa93af6c6c79b5d2dUL, 0xd598e40d3dd89bcfUL,
+  0xd389b47879823479UL, 0x4aff1d108d4ec2c3UL,
+  0x843610cb4bf160cbUL, 0xcedf722a585139baUL,
+  0xa54394fe1eedb8feUL, 0xc2974eb4ee658828UL,
+  0xce947a3da6a9273eUL, 0x733d226229feea32UL,
+  0x811ccc668829b887UL, 0x0806357d5a3f525fUL,
+  0xa163ff802a3426a8UL, 0xca07c2dcb0cf26f7UL,
+  0xc9bcff6034c13052UL, 0xfc89b393dd02f0b5UL,
+  0xfc2c3f3841f17c67UL, 0xbbac2078d443ace2UL,
+  0x9d9ba7832936edc0UL, 0xd54b944b84aa4c0dUL,
+  0xc5029163f384a931UL, 0x0a9e795e65d4df11UL,
+  0xf64335bcf065d37dUL, 0x4d4617b5ff4a16d5UL,
+  0x99ea0196163fa42eUL, 0x504bced1bf8e4e45UL,
+  0xc06481fb9bcf8d39UL, 0xe45ec2862f71e1d6UL,
+  0xf07da27a82c37088UL, 0x5d767327bb4e5a4cUL,
+  0x964e858c91ba2655UL, 0x3a6a07f8d510f86fUL,
+  0xbbe226efb628afeaUL, 0x890489f70a55368bUL,
+  0xeadab0aba3b2dbe5UL, 0x2b45ac74ccea842eUL,
+  0x92c8ae6b464fc96fUL, 0x3b0b8bc90012929dUL,
+  0xb77ada0617e3bbcbUL, 0x09ce6ebb40173744UL,
+  0xe55990879ddcaabdUL, 0xcc420a6a101d0515UL,
+  0x8f57fa54c2a9eab6UL, 0x9fa946824a12232dUL,
+  0xb32df8e9f3546564UL, 0x47939822dc96abf9UL,
+  0xdff9772470297ebdUL, 0x59787e2b93bc56f7UL,
+  0x8bfbea76c619ef36UL, 0x57eb4edb3c55b65aUL,
+  0xaefae51477a06b03UL, 0xede622920b6b23f1UL,
+  0xdab99e59958885c4UL, 0xe95fab368e45ecedUL,
+  0x88b402f7fd75539bUL, 0x11dbcb0218ebb414UL,
+  0xaae103b5fcd2a881UL, 0xd652bdc29f26a119UL,
+  0xd59944a37c0752a2UL, 0x4be76d3346f0495fUL,
+  0x857fcae62d8493a5UL, 0x6f70a4400c562ddbUL,
+  0xa6dfbd9fb8e5b88eUL, 0xcb4ccd500f6bb952UL,
+  0xd097ad07a71f26b2UL, 0x7e2000a41346a7a7UL,
+  0x825ecc24c873782fUL, 0x8ed400668c0c28c8UL,
+  0xa2f67f2dfa90563bUL, 0x728900802f0f32faUL,
+  0xcbb41ef979346bcaUL, 0x4f2b40a03ad2ffb9UL,
+  0xfea126b7d78186bcUL, 0xe2f610c84987bfa8UL,
+  0x9f24b832e6b0f436UL, 0x0dd9ca7d2df4d7c9UL,
+  0xc6ede63fa05d3143UL, 0x91503d1c79720dbbUL,
+  0xf8a95fcf88747d94UL, 0x75a44c6397ce912aUL,
+  0x9b69dbe1b548ce7cUL, 0xc986afbe3ee11abaUL,
+  0xc24452da229b021bUL, 0xfbe85badce996168UL,
+  0xf2d56790ab41c2a2UL, 0xfae27299423fb9c3UL,
+  0x97c560ba6b0919a5UL, 0xdccd879fc967d41aUL,
+  0xbdb6b8e905cb600fUL, 0x5400e987bbc1c920UL,
+  0xed246723473e3813UL, 0x290123e9aab23b68UL,
+  0x9436c0760c86e30bUL, 0xf9a0b6720aaf6521UL,
+  0xb94470938fa89bceUL, 0xf808e40e8d5b3e69UL,
+  0xe7958cb87392c2c2UL, 0xb60b1d1230b20e04UL,
+  0x90bd77f3483bb9b9UL, 0xb1c6f22b5e6f48c2UL,
+  0xb4ecd5f01a4aa828UL, 0x1e38aeb6360b1af3UL,
+  0xe2280b6c20dd5232UL, 0x25c6da63c38de1b0UL,
+  0x8d590723948a535fUL, 0x579c487e5a38ad0eUL,
+  0xb0af48ec79ace837UL, 0x2d835a9df0c6d851UL,
+  0xdcdb1b2798182244UL, 0xf8e431456cf88e65UL,
+  0x8a08f0f8bf0f156bUL, 0x1b8e9ecb641b58ffUL,
+  0xac8b2d36eed2dac5UL, 0xe272467e3d222f3fUL,
+  0xd7adf884aa879177UL, 0x5b0ed81dcc6abb0fUL,
+  0x86ccbb52ea94baeaUL, 0x98e947129fc2b4e9UL,
+  0xa87fea27a539e9a5UL, 0x3f2398d747b36224UL,
+  0xd29fe4b18e88640eUL, 0x8eec7f0d19a03aadUL,
+  0x83a3eeeef9153e89UL, 0x1953cf68300424acUL,
+  0xa48ceaaab75a8e2bUL, 0x5fa8c3423c052dd7UL,
+  0xcdb02555653131b6UL, 0x3792f412cb06794dUL,
+  0x808e17555f3ebf11UL, 0xe2bbd88bbee40bd0UL,
+  0xa0b19d2ab70e6ed6UL, 0x5b6aceaeae9d0ec4UL,
+  0xc8de047564d20a8bUL, 0xf245825a5a445275UL,
+  0xfb158592be068d2eUL, 0xeed6e2f0f0d56712UL,
+  0x9ced737bb6c4183dUL, 0x55464dd69685606bUL,
+  0xc428d05aa4751e4cUL, 0xaa97e14c3c26b886UL,
+  0xf53304714d9265dfUL, 0xd53dd99f4b3066a8UL,
+  0x993fe2c6d07b7fabUL, 0xe546a8038efe4029UL,
+  0xbf8fdb78849a5f96UL, 0xde98520472bdd033UL,
+  0xef73d256a5c0f77cUL, 0x963e66858f6d4440UL,
+  0x95a8637627989aadUL, 0xdde7001379a44aa8UL,
+  0xbb127c53b17ec159UL, 0x5560c018580d5d52UL,
+  0xe9d71b689dde71afUL, 0xaab8f01e6e10b4a6UL,
+  0x9226712162ab070dUL, 0xcab3961304ca70e8UL,
+  0xb6b00d69bb55c8d1UL, 0x3d607b97c5fd0d22UL,
+  0xe45c10c42a2b3b05UL, 0x8cb89a7db77c506aUL,
+  0x8eb98a7a9a5b04e3UL, 0x77f3608e92adb242UL,
+  0xb267ed1940f1c61cUL, 0x55f038b237591ed3UL,
+  0xdf01e85f912e37a3UL, 0x6b6c46dec52f6688UL,
+  0x8b61313bbabce2c6UL, 0x2323ac4b3b3da015UL,
+  0xae397d8aa96c1b77UL, 0xabec975e0a0d081aUL,
+  0xd9c7dced53c72255UL, 0x96e7bd358c904a21UL,
+  0x881cea14545c7575UL, 0x7e50d64177da2e54UL,
+  0xaa242499697392d2UL, 0xdde50bd1d5d0b9e9UL,
+  0xd4ad2dbfc3d07787UL, 0x955e4ec64b44e864UL,
+  0x84ec3c97da624ab4UL, 0xbd5af13bef0b113eUL,
+  0xa6274bbdd0fadd61UL, 0xecb1ad8aeacdd58eUL,
+  0xcfb11ead453994baUL, 0x67de18eda5814af2UL,
+  0x81ceb32c4b43fcf4UL, 0x80eacf948770ced7UL,
+  0xa2425ff75e14fc31UL, 0xa1258379a94d028dUL,
+  0xcad2f7f5359a3b3eUL, 0x096ee45813a04330UL,
+  0xfd87b5f28300ca0dUL, 0x8bca9d6e188853fcUL,
+  0x9e74d1b791e07e48UL, 0x775ea264cf55347eUL,
+  0xc612062576589ddaUL, 0x95364afe032a819eUL,
+  0xf79687aed3eec551UL, 0x3a83ddbd83f52205UL,
+  0x9abe14cd44753b52UL, 0xc4926a9672793543UL,
+  0xc16d9a0095928a27UL, 0x75b7053c0f178294UL,
+  0xf1c90080baf72cb1UL, 0x5324c68b12dd6339UL,
+  0x971da05074da7beeUL, 0xd3f6fc16ebca5e04UL,
+  0xbce5086492111aeaUL, 0x88f4bb1ca6bcf585UL,
+  0xec1e4a7db69561a5UL, 0x2b31e9e3d06c32e6UL,
+  0x9392ee8e921d5d07UL, 0x3aff322e62439fd0UL,
+  0xb877aa3236a4b449UL, 0x09befeb9fad487c3UL,
+  0xe69594bec44de15bUL, 0x4c2ebe687989a9b4UL,
+  0x901d7cf73ab0acd9UL, 0x0f9d37014bf60a11UL,
+  0xb424dc35095cd80fUL, 0x538484c19ef38c95UL,
+  0xe12e13424bb40e13UL, 0x2865a5f206b06fbaUL,
+  0x8cbccc096f5088cbUL, 0xf93f87b7442e45d4UL,
+  0xafebff0bcb24aafeUL, 0xf78f69a51539d749UL,
+  0xdbe6fecebdedd5beUL, 0xb573440e5a884d1cUL,
+  0x89705f4136b4a597UL, 0x31680a88f8953031UL,
+  0xabcc77118461cefcUL, 0xfdc20d2b36ba7c3eUL,
+  0xd6bf94d5e57a42bcUL, 0x3d32907604691b4dUL,
+  0x8637bd05af6c69b5UL, 0xa63f9a49c2c1b110UL,
+  0xa7c5ac471b478423UL, 0x0fcf80dc33721d54UL,
+  0xd1b71758e219652bUL, 0xd3c36113404ea4a9UL,
+  0x83126e978d4fdf3bUL, 0x645a1cac083126eaUL,
+  0xa3d70a3d70a3d70aUL, 0x3d70a3d70a3d70a4UL,
+  0xccccccccccccccccUL, 0xcccccccccccccccdUL,
+  0x8000000000000000UL, 0x0000000000000000UL,
+  0xa000000000000000UL, 0x0000000000000000UL,
+  0xc800000000000000UL, 0x0000000000000000UL,
+  0xfa00000000000000UL, 0x0000000000000000UL,
+  0x9c40000000000000UL, 0x0000000000000000UL,
+  0xc350000000000000UL, 0x0000000000000000UL,
+  0xf424000000000000UL, 0x0000000000000000UL,
+  0x9896800000000000UL, 0x0000000000000000UL,
+  0xbebc200000000000UL, 0x0000000000000000UL,
+  0xee6b280000000000UL, 0x0000000000000000UL,
+  0x9502f90000000000UL, 0x0000000000000000UL,
+  0xba43b74000000000UL, 0x0000000000000000UL,
+  0xe8d4a51000000000UL, 0x0000000000000000UL,
+  0x9184e72a00000000UL, 0x0000000000000000UL,
+  0xb5e620f480000000UL, 0x0000000000000000UL,
+  0xe35fa931a0000000UL, 0x0000000000000000UL,
+  0x8e1bc9bf04000000UL, 0x0000000000000000UL,
+  0xb1a2bc2ec5000000UL, 0x0000000000000000UL,
+  0xde0b6b3a76400000UL, 0x0000000000000000UL,
+  0x8ac7230489e80000UL, 0x0000000000000000UL,
+  0xad78ebc5ac620000UL, 0x0000000000000000UL,
+  0xd8d726b7177a8000UL, 0x0000000000000000UL,
+  0x878678326eac9000UL, 0x0000000000000000UL,
+  0xa968163f0a57b400UL, 0x0000000000000000UL,
+  0xd3c21bcecceda100UL, 0x0000000000000000UL,
+  0x84595161401484a0UL, 0x0000000000000000UL,
+  0xa56fa5b99019a5c8UL, 0x0000000000000000UL,
+  0xcecb8f27f4200f3aUL, 0x0000000000000000UL,
+  0x813f3978f8940984UL, 0x4000000000000000UL,
+  0xa18f07d736b90be5UL, 0x5000000000000000UL,
+  0xc9f2c9cd04674edeUL, 0xa400000000000000UL,
+  0xfc6f7c4045812296UL, 0x4d00000000000000UL,
+  0x9dc5ada82b70b59dUL, 0xf020000000000000UL,
+  0xc5371912364ce305UL, 0x6c28000000000000UL,
+  0xf684df56c3e01bc6UL, 0xc732000000000000UL,
+  0x9a130b963a6c115cUL, 0x3c7f400000000000UL,
+  0xc097ce7bc90715b3UL, 0x4b9f100000000000UL,
+  0xf0bdc21abb48db20UL, 0x1e86d40000000000UL,
+  0x96769950b50d88f4UL, 0x1314448000000000UL,
+  0xbc143fa4e250eb31UL, 0x17d955a000000000UL,
+  0xeb194f8e1ae525fdUL, 0x5dcfab0800000000UL,
+  0x92efd1b8d0cf37beUL, 0x5aa1cae500000000UL,
+  0xb7abc627050305adUL, 0xf14a3d9e40000000UL,
+  0xe596b7b0c643c719UL, 0x6d9ccd05d0000000UL,
+  0x8f7e32ce7bea5c6fUL, 0xe4820023a2000000UL,
+  0xb35dbf821ae4f38bUL, 0xdda2802c8a800000UL,
+  0xe0352f62a19e306eUL, 0xd50b2037ad200000UL,
+  0x8c213d9da502de45UL, 0x4526f422cc340000UL,
+  0xaf298d050e4395d6UL, 0x9670b12b7f410000UL,
+  0xdaf3f04651d47b4cUL, 0x3c0cdd765f114000UL,
+  0x88d8762bf324cd0fUL, 0xa5880a69fb6ac800UL,
+  0xab0e93b6efee0053UL, 0x8eea0d047a457a00UL,
+  0xd5d238a4abe98068UL, 0x72a4904598d6d880UL,
+  0x85a36366eb71f041UL, 0x47a6da2b7f864750UL,
+  0xa70c3c40a64e6c51UL, 0x999090b65f67d924UL,
+  0xd0cf4b50cfe20765UL, 0xfff4b4e3f741cf6dUL,
+  0x82818f1281ed449fUL, 0xbff8f10e7a8921a4UL,
+  0xa321f2d7226895c7UL, 0xaff72d52192b6a0dUL,
+  0xcbea6f8ceb02bb39UL, 0x9bf4f8a69f764490UL,
+  0xfee50b7025c36a08UL, 0x02f236d04753d5b4UL,
+  0x9f4f2726179a2245UL, 0x01d762422c946590UL,
+  0xc722f0ef9d80aad6UL, 0x424d3ad2b7b97ef5UL,
+  0xf8ebad2b84e0d58bUL, 0xd2e0898765a7deb2UL,
+  0x9b934c3b330c8577UL, 0x63cc55f49f88eb2fUL,
+  0xc2781f49ffcfa6d5UL, 0x3cbf6b71c76b25fbUL,
+  0xf316271c7fc3908aUL, 0x8bef464e3945ef7aUL,
+  0x97edd871cfda3a56UL, 0x97758bf0e3cbb5acUL,
+  0xbde94e8e43d0c8ecUL, 0x3d52eeed1cbea317UL,
+  0xed63a231d4c4fb27UL, 0x4ca7aaa863ee4bddUL,
+  0x945e455f24fb1cf8UL, 0x8fe8caa93e74ef6aUL,
+  0xb975d6b6ee39e436UL, 0xb3e2fd538e122b44UL,
+  0xe7d34c64a9c85d44UL, 0x60dbbca87196b616UL,
+  0x90e40fbeea1d3a4aUL, 0xbc8955e946fe31cdUL,
+  0xb51d13aea4a488ddUL, 0x6babab6398bdbe41UL,
+  0xe264589a4dcdab14UL, 0xc696963c7eed2dd1UL,
+  0x8d7eb76070a08aecUL, 0xfc1e1de5cf543ca2UL,
+  0xb0de65388cc8ada8UL, 0x3b25a55f43294bcbUL,
+  0xdd15fe86affad912UL, 0x49ef0eb713f39ebeUL,
+  0x8a2dbf142dfcc7abUL, 0x6e3569326c784337UL,
+  0xacb92ed9397bf996UL, 0x49c2c37f07965404UL,
+  0xd7e77a8f87daf7fbUL, 0xdc33745ec97be906UL,
+  0x86f0ac99b4e8dafdUL, 0x69a028bb3ded71a3UL,
+  0xa8acd7c0222311bcUL, 0xc40832ea0d68ce0cUL,
+  0xd2d80db02aabd62bUL, 0xf50a3fa490c30190UL,
+  0x83c7088e1aab65dbUL, 0x792667c6da79e0faUL,
+  0xa4b8cab1a1563f52UL, 0x577001b891185938UL,
+  0xcde6fd5e09abcf26UL, 0xed4c0226b55e6f86UL,
+  0x80b05e5ac60b6178UL, 0x544f8158315b05b4UL,
+  0xa0dc75f1778e39d6UL, 0x696361ae3db1c721UL,
+  0xc913936dd571c84cUL, 0x03bc3a19cd1e38e9UL,
+  0xfb5878494ace3a5fUL, 0x04ab48a04065c723UL,
+  0x9d174b2dcec0e47bUL, 0x62eb0d64283f9c76UL,
+  0xc45d1df942711d9aUL, 0x3ba5d0bd324f8394UL,
+  0xf5746577930d6500UL, 0xca8f44ec7ee36479UL,
+  0x9968bf6abbe85f20UL, 0x7e998b13cf4e1ecbUL,
+  0xbfc2ef456ae276e8UL, 0x9e3fedd8c321a67eUL,
+  0xefb3ab16c59b14a2UL, 0xc5cfe94ef3ea101eUL,
+  0x95d04aee3b80ece5UL, 0xbba1f1d158724a12UL,
+  0xbb445da9ca61281fUL, 0x2a8a6e45ae8edc97UL,
+  0xea1575143cf97226UL, 0xf52d09d71a3293bdUL,
+  0x924d692ca61be758UL, 0x593c2626705f9c56UL,
+  0xb6e0c377cfa2e12eUL, 0x6f8b2fb00c77836cUL,
+  0xe498f455c38b997aUL, 0x0b6dfb9c0f956447UL,
+  0x8edf98b59a373fecUL, 0x4724bd4189bd5eacUL,
+  0xb2977ee300c50fe7UL, 0x58edec91ec2cb657UL,
+  0xdf3d5e9bc0f653e1UL, 0x2f2967b66737e3edUL,
+  0x8b865b215899f46cUL, 0xbd79e0d20082ee74UL,
+  0xae67f1e9aec07187UL, 0xecd8590680a3aa11UL,
+  0xda01ee641a708de9UL, 0xe80e6f4820cc9495UL,
+  0x884134fe908658b2UL, 0x3109058d147fdcddUL,
+  0xaa51823e34a7eedeUL, 0xbd4b46f0599fd415UL,
+  0xd4e5e2cdc1d1ea96UL, 0x6c9e18ac7007c91aUL,
+  0x850fadc09923329eUL, 0x03e2cf6bc604ddb0UL,
+  0xa6539930bf6bff45UL, 0x84db8346b786151cUL,
+  0xcfe87f7cef46ff16UL, 0xe612641865679a63UL,
+  0x81f14fae158c5f6eUL, 0x4fcb7e8f3f60c07eUL,
+  0xa26da3999aef7749UL, 0xe3be5e330f38f09dUL,
+  0xcb090c8001ab551cUL, 0x5cadf5bfd3072cc5UL,
+  0xfdcb4fa002162a63UL, 0x73d9732fc7c8f7f6UL,
+  0x9e9f11c4014dda7eUL, 0x2867e7fddcdd9afaUL,
+  0xc646d63501a1511dUL, 0xb281e1fd541501b8UL,
+  0xf7d88bc24209a565UL, 0x1f225a7ca91a4226UL,
+  0x9ae757596946075fUL, 0x3375788de9b06958UL,
+  0xc1a12d2fc3978937UL, 0x0052d6b1641c83aeUL,
+  0xf209787bb47d6b84UL, 0xc0678c5dbd23a49aUL,
+  0x9745eb4d50ce6332UL, 0xf840b7ba963646e0UL,
+  0xbd176620a501fbffUL, 0xb650e5a93bc3d898UL,
+  0xec5d3fa8ce427affUL, 0xa3e51f138ab4cebeUL,
+  0x93ba47c980e98cdfUL, 0xc66f336c36b10137UL,
+  0xb8a8d9bbe123f017UL, 0xb80b0047445d4184UL,
+  0xe6d3102ad96cec1dUL, 0xa60dc059157491e5UL,
+  0x9043ea1ac7e41392UL, 0x87c89837ad68db2fUL,
+  0xb454e4a179dd1877UL, 0x29babe4598c311fbUL,
+  0xe16a1dc9d8545e94UL, 0xf4296dd6fef3d67aUL,
+  0x8ce2529e2734bb1dUL, 0x1899e4a65f58660cUL,
+  0xb01ae745b101e9e4UL, 0x5ec05dcff72e7f8fUL,
+  0xdc21a1171d42645dUL, 0x76707543f4fa1f73UL,
+  0x899504ae72497ebaUL, 0x6a06494a791c53a8UL,
+  0xabfa45da0edbde69UL, 0x0487db9d17636892UL,
+  0xd6f8d7509292d603UL, 0x45a9d2845d3c42b6UL,
+  0x865b86925b9bc5c2UL, 0x0b8a2392ba45a9b2UL,
+  0xa7f26836f282b732UL, 0x8e6cac7768d7141eUL,
+  0xd1ef0244af2364ffUL, 0x3207d795430cd926UL,
+  0x8335616aed761f1fUL, 0x7f44e6bd49e807b8UL,
+  0xa402b9c5a8d3a6e7UL, 0x5f16206c9c6209a6UL,
+  0xcd036837130890a1UL, 0x36dba887c37a8c0fUL,
+  0x802221226be55a64UL, 0xc2494954da2c9789UL,
+  0xa02aa96b06deb0fdUL, 0xf2db9baa10b7bd6cUL,
+  0xc83553c5c8965d3dUL, 0x6f92829494e5acc7UL,
+  0xfa42a8b73abbf48cUL, 0xcb772339ba1f17f9UL,
+  0x9c69a97284b578d7UL, 0xff2a760414536efbUL,
+  0xc38413cf25e2d70dUL, 0xfef5138519684abaUL,
+  0xf46518c2ef5b8cd1UL, 0x7eb258665fc25d69UL,
+  0x98bf2f79d5993802UL, 0xef2f773ffbd97a61UL,
+  0xbeeefb584aff8603UL, 0xaafb550ffacfd8faUL,
+  0xeeaaba2e5dbf6784UL, 0x95ba2a53f983cf38UL,
+  0x952ab45cfa97a0b2UL, 0xdd945a747bf26183UL,
+  0xba756174393d88dfUL, 0x94f971119aeef9e4UL,
+  0xe912b9d1478ceb17UL, 0x7a37cd5601aab85dUL,
+  0x91abb422ccb812eeUL, 0xac62e055c10ab33aUL,
+  0xb616a12b7fe617aaUL, 0x577b986b314d6009UL,
+  0xe39c49765fdf9d94UL, 0xed5a7e85fda0b80bUL,
+  0x8e41ade9fbebc27dUL, 0x14588f13be847307UL,
+  0xb1d219647ae6b31cUL, 0x596eb2d8ae258fc8UL,
+  0xde469fbd99a05fe3UL, 0x6fca5f8ed9aef3bbUL,
+  0x8aec23d680043beeUL, 0x25de7bb9480d5854UL,
+  0xada72ccc20054ae9UL, 0xaf561aa79a10ae6aUL,
+  0xd910f7ff28069da4UL, 0x1b2ba1518094da04UL,
+  0x87aa9aff79042286UL, 0x90fb44d2f05d0842UL,
+  0xa99541bf57452b28UL, 0x353a1607ac744a53UL,
+  0xd3fa922f2d1675f2UL, 0x42889b8997915ce8UL,
+  0x847c9b5d7c2e09b7UL, 0x69956135febada11UL,
+  0xa59bc234db398c25UL, 0x43fab9837e699095UL,
+  0xcf02b2c21207ef2eUL, 0x94f967e45e03f4bbUL,
+  0x8161afb94b44f57dUL, 0x1d1be0eebac278f5UL,
+  0xa1ba1ba79e1632dcUL, 0x6462d92a69731732UL,
+  0xca28a291859bbf93UL, 0x7d7b8f7503cfdcfeUL,
+  0xfcb2cb35e702af78UL, 0x5cda735244c3d43eUL,
+  0x9defbf01b061adabUL, 0x3a0888136afa64a7UL,
+  0xc56baec21c7a1916UL, 0x088aaa1845b8fdd0UL,
+  0xf6c69a72a3989f5bUL, 0x8aad549e57273d45UL,
+  0x9a3c2087a63f6399UL, 0x36ac54e2f678864bUL,
+  0xc0cb28a98fcf3c7fUL, 0x84576a1bb416a7ddUL,
+  0xf0fdf2d3f3c30b9fUL, 0x656d44a2a11c51d5UL,
+  0x969eb7c47859e743UL, 0x9f644ae5a4b1b325UL,
+  0xbc4665b596706114UL, 0x873d5d9f0dde1feeUL,
+  0xeb57ff22fc0c7959UL, 0xa90cb506d155a7eaUL,
+  0x9316ff75dd87cbd8UL, 0x09a7f12442d588f2UL,
+  0xb7dcbf5354e9beceUL, 0x0c11ed6d538aeb2fUL,
+  0xe5d3ef282a242e81UL, 0x8f1668c8a86da5faUL,
+  0x8fa475791a569d10UL, 0xf96e017d694487bcUL,
+  0xb38d92d760ec4455UL, 0x37c981dcc395a9acUL,
+  0xe070f78d3927556aUL, 0x85bbe253f47b1417UL,
+  0x8c469ab843b89562UL, 0x93956d7478ccec8eUL,
+  0xaf58416654a6babbUL, 0x387ac8d1970027b2UL,
+  0xdb2e51bfe9d0696aUL, 0x06997b05fcc0319eUL,
+  0x88fcf317f22241e2UL, 0x441fece3bdf81f03UL,
+  0xab3c2fddeeaad25aUL, 0xd527e81cad7626c3UL,
+  0xd60b3bd56a5586f1UL, 0x8a71e223d8d3b074UL,
+  0x85c7056562757456UL, 0xf6872d5667844e49UL,
+  0xa738c6bebb12d16cUL, 0xb428f8ac016561dbUL,
+  0xd106f86e69d785c7UL, 0xe13336d701beba52UL,
+  0x82a45b450226b39cUL, 0xecc0024661173473UL,
+  0xa34d721642b06084UL, 0x27f002d7f95d0190UL,
+  0xcc20ce9bd35c78a5UL, 0x31ec038df7b441f4UL,
+  0xff290242c83396ceUL, 0x7e67047175a15271UL,
+  0x9f79a169bd203e41UL, 0x0f0062c6e984d386UL,
+  0xc75809c42c684dd1UL, 0x52c07b78a3e60868UL,
+  0xf92e0c3537826145UL, 0xa7709a56ccdf8a82UL,
+  0x9bbcc7a142b17ccbUL, 0x88a66076400bb691UL,
+  0xc2abf989935ddbfeUL, 0x6acff893d00ea435UL,
+  0xf356f7ebf83552feUL, 0x0583f6b8c4124d43UL,
+  0x98165af37b2153deUL, 0xc3727a337a8b704aUL,
+  0xbe1bf1b059e9a8d6UL, 0x744f18c0592e4c5cUL,
+  0xeda2ee1c7064130cUL, 0x1162def06f79df73UL,
+  0x9485d4d1c63e8be7UL, 0x8addcb5645ac2ba8UL,
+  0xb9a74a0637ce2ee1UL, 0x6d953e2bd7173692UL,
+  0xe8111c87c5c1ba99UL, 0xc8fa8db6ccdd0437UL,
+  0x910ab1d4db9914a0UL, 0x1d9c9892400a22a2UL,
+  0xb54d5e4a127f59c8UL, 0x2503beb6d00cab4bUL,
+  0xe2a0b5dc971f303aUL, 0x2e44ae64840fd61dUL,
+  0x8da471a9de737e24UL, 0x5ceaecfed289e5d2UL,
+  0xb10d8e1456105dadUL, 0x7425a83e872c5f47UL,
+  0xdd50f1996b947518UL, 0xd12f124e28f77719UL,
+  0x8a5296ffe33cc92fUL, 0x82bd6b70d99aaa6fUL,
+  0xace73cbfdc0bfb7bUL, 0x636cc64d1001550bUL,
+  0xd8210befd30efa5aUL, 0x3c47f7e05401aa4eUL,
+  0x8714a775e3e95c78UL, 0x65acfaec34810a71UL,
+  0xa8d9d1535ce3b396UL, 0x7f1839a741a14d0dUL,
+  0xd31045a8341ca07cUL, 0x1ede48111209a050UL,
+  0x83ea2b892091e44dUL, 0x934aed0aab460432UL,
+  0xa4e4b66b68b65d60UL, 0xf81da84d5617853fUL,
+  0xce1de40642e3f4b9UL, 0x36251260ab9d668eUL,
+  0x80d2ae83e9ce78f3UL, 0xc1d72b7c6b426019UL,
+  0xa1075a24e4421730UL, 0xb24cf65b8612f81fUL,
+  0xc94930ae1d529cfcUL, 0xdee033f26797b627UL,
+  0xfb9b7cd9a4a7443cUL, 0x169840ef017da3b1UL,
+  0x9d412e0806e88aa5UL, 0x8e1f289560ee864eUL,
+  0xc491798a08a2ad4eUL, 0xf1a6f2bab92a27e2UL,
+  0xf5b5d7ec8acb58a2UL, 0xae10af696774b1dbUL,
+  0x9991a6f3d6bf1765UL, 0xacca6da1e0a8ef29UL,
+  0xbff610b0cc6edd3fUL, 0x17fd090a58d32af3UL,
+  0xeff394dcff8a948eUL, 0xddfc4b4cef07f5b0UL,
+  0x95f83d0a1fb69cd9UL, 0x4abdaf101564f98eUL,
+  0xbb764c4ca7a4440fUL, 0x9d6d1ad41abe37f1UL,
+  0xea53df5fd18d5513UL, 0x84c86189216dc5edUL,
+  0x92746b9be2f8552cUL, 0x32fd3cf5b4e49bb4UL,
+  0xb7118682dbb66a77UL, 0x3fbc8c33221dc2a1UL,
+  0xe4d5e82392a40515UL, 0x0fabaf3feaa5334aUL,
+  0x8f05b1163ba6832dUL, 0x29cb4d87f2a7400eUL,
+  0xb2c71d5bca9023f8UL, 0x743e20e9ef511012UL,
+  0xdf78e4b2bd342cf6UL, 0x914da9246b255416UL,
+  0x8bab8eefb6409c1aUL, 0x1ad089b6c2f7548eUL,
+  0xae9672aba3d0c320UL, 0xa184ac2473b529b1UL,
+  0xda3c0f568cc4f3e8UL, 0xc9e5d72d90a2741eUL,
+  0x8865899617fb1871UL, 0x7e2fa67c7a658892UL,
+  0xaa7eebfb9df9de8dUL, 0xddbb901b98feeab7UL,
+  0xd51ea6fa85785631UL, 0x552a74227f3ea565UL,
+  0x8533285c936b35deUL, 0xd53a88958f87275fUL,
+  0xa67ff273b8460356UL, 0x8a892abaf368f137UL,
+  0xd01fef10a657842cUL, 0x2d2b7569b0432d85UL,
+  0x8213f56a67f6b29bUL, 0x9c3b29620e29fc73UL,
+  0xa298f2c501f45f42UL, 0x8349f3ba91b47b8fUL,
+  0xcb3f2f7642717713UL, 0x241c70a936219a73UL,
+  0xfe0efb53d30dd4d7UL, 0xed238cd383aa0110UL,
+  0x9ec95d1463e8a506UL, 0xf4363804324a40aaUL,
+  0xc67bb4597ce2ce48UL, 0xb143c6053edcd0d5UL,
+  0xf81aa16fdc1b81daUL, 0xdd94b7868e94050aUL,
+  0x9b10a4e5e9913128UL, 0xca7cf2b4191c8326UL,
+  0xc1d4ce1f63f57d72UL, 0xfd1c2f611f63a3f0UL,
+  0xf24a01a73cf2dccfUL, 0xbc633b39673c8cecUL,
+  0x976e41088617ca01UL, 0xd5be0503e085d813UL,
+  0xbd49d14aa79dbc82UL, 0x4b2d8644d8a74e18UL,
+  0xec9c459d51852ba2UL, 0xddf8e7d60ed1219eUL,
+  0x93e1ab8252f33b45UL, 0xcabb90e5c942b503UL,
+  0xb8da1662e7b00a17UL, 0x3d6a751f3b936243UL,
+  0xe7109bfba19c0c9dUL, 0x0cc512670a783ad4UL,
+  0x906a617d450187e2UL, 0x27fb2b80668b24c5UL,
+  0xb484f9dc9641e9daUL, 0xb1f9f660802dedf6UL,
+  0xe1a63853bbd26451UL, 0x5e7873f8a0396973UL,
+  0x8d07e33455637eb2UL, 0xdb0b487b6423e1e8UL,
+  0xb049dc016abc5e5fUL, 0x91ce1a9a3d2cda62UL,
+  0xdc5c5301c56b75f7UL, 0x7641a140cc7810fbUL,
+  0x89b9b3e11b6329baUL, 0xa9e904c87fcb0a9dUL,
+  0xac2820d9623bf429UL, 0x546345fa9fbdcd44UL,
+  0xd732290fbacaf133UL, 0xa97c177947ad4095UL,
+  0x867f59a9d4bed6c0UL, 0x49ed8eabcccc485dUL,
+  0xa81f301449ee8c70UL, 0x5c68f256bfff5a74UL,
+  0xd226fc195c6a2f8cUL, 0x73832eec6fff3111UL,
+  0x83585d8fd9c25db7UL, 0xc831fd53c5ff7eabUL,
+  0xa42e74f3d032f525UL, 0xba3e7ca8b77f5e55UL,
+  0xcd3a1230c43fb26fUL, 0x28ce1bd2e55f35ebUL,
+  0x80444b5e7aa7cf85UL, 0x7980d163cf5b81b3UL,
+  0xa0555e361951c366UL, 0xd7e105bcc332621fUL,
+  0xc86ab5c39fa63440UL, 0x8dd9472bf3fefaa7UL,
+  0xfa856334878fc150UL, 0xb14f98f6f0feb951UL,
+  0x9c935e00d4b9d8d2UL, 0x6ed1bf9a569f33d3UL,
+  0xc3b8358109e84f07UL, 0x0a862f80ec4700c8UL,
+  0xf4a642e14c6262c8UL, 0xcd27bb612758c0faUL,
+  0x98e7e9cccfbd7dbdUL, 0x8038d51cb897789cUL,
+  0xbf21e44003acdd2cUL, 0xe0470a63e6bd56c3UL,
+  0xeeea5d5004981478UL, 0x1858ccfce06cac74UL,
+  0x95527a5202df0ccbUL, 0x0f37801e0c43ebc8UL,
+  0xbaa718e68396cffdUL, 0xd30560258f54e6baUL,
+  0xe950df20247c83fdUL, 0x47c6b82ef32a2069UL,
+  0x91d28b7416cdd27eUL, 0x4cdc331d57fa5441UL,
+  0xb6472e511c81471dUL, 0xe0133fe4adf8e952UL,
+  0xe3d8f9e563a198e5UL, 0x58180fddd97723a6UL,
+  0x8e679c2f5e44ff8fUL, 0x570f09eaa7ea7648UL
+};
+
+static const double hlPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#if defined(__GNUC__)
+#define hl_nclz(x) __builtin_clzl(x)
+#else
+static int hl_nclz( unsigned long x ){
+  int i = 0;
+  while( !(x & (1UL << 63)) ){
+    x <<= 1;
+    i++;
+  }
+  return i;
+}
+#endif
+
+#define hl_isxdigit(x) (hl_isdigit(x) || (((x) | 0x20) >= 'a' && ((x) | 0x20) <= 'f'))
+#define hl_xval(x)     (hl_isdigit(x) ? (x) - '0' : ((x) | 0x20) - 'a' + 10)
+
+/* the 128 bit product of a and b */
+static void hl_nmul( unsigned long a, unsigned long b, unsigned long* hi, unsigned long* lo ){
+  unsigned long al = a & 0xffffffffUL, ah = a >> 32, bl = b & 0xffffffffUL, bh = b >> 32;
+  unsigned long ll = al * bl, lh = al * bh, hl = ah * bl;
+  unsigned long m = (ll >> 32) + (lh & 0xffffffffUL) + (hl & 0xffffffffUL);
+  *lo = (m << 32) | (ll & 0xffffffffUL);
+  *hi = ah * bh + (lh >> 32) + (hl >> 32) + (m >> 32);
+}
+
+/* w * 10^q correctly rounded, for w of 1 to 19 digits */
+static hlNum_t hl_nlemire( unsigned long w, int q ){
+  unsigned long hi, lo, h2, l2, m;
+  long p2, t;
+  int lz, up, sh, i;
+  hlNum_t d;
+  if( q < HL_NMINQ ) return 0;
+  if( q > HL_NMAXQ ){
+    m = 0x7ffUL << 52;
+    goto done;
+  }
+  lz = hl_nclz(w);
+  w <<= lz;
+  i = 2 * (q - HL_NMINQ);
+  hl_nmul(w, hlPow5[i], &hi, &lo);
+  /* the low word only matters if the bits below the mantissa are all set */
+  if( (hi & 0x1ff) == 0x1ff ){
+    hl_nmul(w, hlPow5[i + 1], &h2, &l2);
+    lo += h2;
+    if( h2 > lo ) hi++;
+  }
+  up = hi >> 63;
+  sh = up + 9;
+  m = hi >> sh;
+  /* floor(log2(10^q)) + 63, then biased */
+  t = 217706L * q;
+  p2 = (t >= 0 ? t >> 16 : -((-t + 65535) >> 16)) + 63 + up - lz + 1023;
+  if( p2 <= 0 ){ /* subnormal, unless rounding carries into the smallest normal */
+    if( -p2 + 1 >= 64 ) return 0;
+    m >>= -p2 + 1;
+    m += m & 1;
+    m >>= 1;
+    m |= (unsigned long)(m >= (1UL << 52)) << 52;
+    goto done;
+  }
+  /* exactly halfway rounds to even, only possible for small q */
+  if( lo <= 1 && q >= -4 && q <= 23 && (m & 3) == 1 && (m << sh) == hi ) m &= ~1UL;
+  m += m & 1;
+  m >>= 1;
+  if( m >= (2UL << 52) ){
+    m = 1UL << 52;
+    p2++;
+  }
+  m &= ~(1UL << 52);
+  m = p2 >= 0x7ff ? 0x7ffUL << 52 : m | (unsigned long)p2 << 52;
+done:
+  memcpy(&d, &m, sizeof(d));
+  return d;
+}
+
+/* the bytes p[x..i) as a double, for significands too long to be exact */
+static hlNum_t hl_nslow( unsigned char* p, int x, int i ){
+  char b[64], *c = i - x < (int)sizeof(b) ? b : malloc(i - x + 1);
+  hlNum_t r = 0;
+  if( c ){
+    memcpy(c, p + x, i - x);
+    c[i - x] = 0;
+    r = strtod(c, NULL);
+    if( c != b ) free(c);
+  }
+  return r;
+}
+
+static void pnumber( hlState_t* s, unsigned char* p, int x, int n ){
+  unsigned long w = 0;
+  int i = x, nd = 0, q = 0, e, j, neg, more = 0;
+  hlNum_t r;
+  if( p[x] == '0' && x + 2 < n && (p[x + 1] | 0x20) == 'x' && hl_isxdigit(p[x + 2]) ){
+    /* 16 digits fill w, later ones only shift and stick to its last bit */
+    for( i = x + 2, e = 0; i < n && hl_isxdigit(p[i]); i++ ){
+      if( nd < 16 ){
+        w = w << 4 | hl_xval(p[i]);
+        nd += w != 0;
+      } else {
+        e++;
+        more |= p[i] != '0';
+      }
+    }
+    for( r = (hlNum_t)(w | more); e--; ) r *= 16;
+  } else {
+    for( ; i < n && hl_isdigit(p[i]); i++ ){
+      if( nd < 19 ){
+        w = w * 10 + (p[i] - '0');
+        nd += w != 0;
+      } else {
+        q++;
+        more |= p[i] != '0';
+      }
+    }
+    /* a . must be followed by a digit, 1..2 is a range */
+    if( i + 1 < n && p[i] == '.' && hl_isdigit(p[i + 1]) ){
+      for( i++; i < n && hl_isdigit(p[i]); i++ ){
+        if( nd < 19 ){
+          w = w * 10 + (p[i] - '0');
+          nd += w != 0;
+          q--;
+        } else more |= p[i] != '0';
+      }
+    }
+    if( i < n && (p[i] | 0x20) == 'e' ){
+      j = i + 1;
+      neg = 0;
+      if( j < n && (p[j] == '+' || p[j] == '-') ) neg = p[j++] == '-';
+      if( j < n && hl_isdigit(p[j]) ){
+        for( e = 0; j < n && hl_isdigit(p[j]); j++ ) 
+          if( e < 100000 ) e = e * 10 + (p[j] - '0');
+        q += neg ? -e : e;
+        i = j;
+      }
+    }
+    if( more ) r = hl_nslow(p, x, i);
+    else if( !w ) r = 0;
+    else if( q >= -22 && q <= 22 && w <= (1UL << 53) ) 
+      r = q < 0 ? (hlNum_t)w / hlPow10[-q] : (hlNum_t)w * hlPow10[q];
+    else r = hl_nlemire(w, q);
+  }
+  s->ctok.value.number = r;
+  s->ctok.l = i - x;
+  s->ptr = i;
+  s->ctok.type = tk_number;
+}
+
+static int isreserved( hlState_t* s, unsigned char* str, unsigned l ){
+  int i = hlLexKw[hl_lkwhash(str, l)];
+  if( 
+    i < 0 || 
+    !hl_ismatch(str, hlTkns[i], l) || 
+    hlTkns[i][l] 
+  ) return 0;
+  if( i == tk_true || i == tk_false ){
+    s->ctok.type = tk_boolean; 
+    s->ctok.value.number = (i == tk_true); 
+  } else {
+    s->ctok.type = i;
+  }
+  s->ptr += l;
+  return 1;
+}
+
+/* load the next token of s->toks, the last one repeats */
+static void nexttok( hlState_t* s ){
+  hlTokens_t* t = s->toks;
+  int i = s->tp < t->n - 1 ? s->tp++ : t->n - 1;
+  s->ctok.type = t->type[i];
+  s->ctok.off = t->off[i];
+  s->ctok.l = t->len[i];
+  switch( s->ctok.type ){
+    case tk_number: s->ctok.value.number = t->num[t->lit[i]]; break;
+    case tk_boolean: s->ctok.value.number = t->lit[i]; break;
+    default: s->ctok.value.id = t->lit[i]; break;
+  }
+}
+
+/* the type of the k-th token after ctok, only with s->toks */
+#define lookahead(s, k) \
+  ((s)->tp + (k) - 1 < (s)->toks->n ? (s)->toks->type[(s)->tp + (k) - 1] : tk_eof)
+
+static void next( hlState_t* s ){
+  int i, x, st, e, n;
+  unsigned char* p = s->prog;
+  hl_eabort(s);
+  s->ptok = s->ctok;
+  if( s->toks ){
+    nexttok(s);
+    return;
+  }
+  if( !s->pend ) s->pend = p + strlen((const char *)p);
+  n = s->pend - p;
+check_comments:
+  /* single spaces are common enough to skip before scanning */
+  if( 
+    s->ptr < n && hl_isspace(p[s->ptr]) && 
+    ++(s->ptr) < n && hl_isspace(p[s->ptr]) 
+  ) s->ptr = hl_lscan(p, s->ptr, n, hlLexSpace, 0);
+
+  /* inline comments start with -- */
+  if( s->ptr + 1 < n && hl_ismatch(p + s->ptr, "--", 2) ){
+    s->ptr = hl_lscan(p, s->ptr + 2, n, hlLexLine, 1);
+    goto check_comments; 
+  }
+   /* block comments start with /- and end with -/ */
+  if( s->ptr + 1 < n && hl_ismatch(p + s->ptr, "/-", 2) ){
+    for( i = s->ptr + 1; (i = hl_lscan(p, i, n, hlLexDash, 1)) + 1 < n && p[i + 1] != '/'; i++ );
+    s->ptr = i + 1 < n ? i + 2 : n;
+    goto check_comments;
+  }
+
+  x = s->ctok.off = s->ptr;
+  if( x >= n ){
+    s->ctok.type = tk_eof;
+    s->ctok.l = 0;
+    return;
+  }
+  /* check for symbols */
+  for( st = 0, i = x, e = -1; i < n && p[i] < 128 && (st = hlLexNext[st][p[i]]); ){
+    i++;
+    if( hlLexTok[st] >= 0 ){
+      s->ctok.type = hlLexTok[st];
+      e = i;
+    }
+  }
+  if( e >= 0 ){
+    s->ctok.l = e - x;
+    s->ptr = e;
+    return;
+  }
+  switch( p[x] ){
+    case '\'':
+    case '"': {
+      int esc = 0;
+      /* a backslash escapes the byte after it */
+      for( i = x + 1; (i = hl_lscan(p, i, n, p[x] == '"' ? hlLexDq : hlLexSq, 1)) < n && p[i] == '\\'; i += 2 ) 
+        esc = 1;
+      if( i >= n ){
+        s->error = 1;
+        return;
+      }
+      i -= x;
+      /* only literals with escapes need a copy to intern */
+      s->ctok.value.id = esc ? pstring(s, p + x + 1, i - 1) : hl_intern(s, p + x + 1, i - 1);
+      s->ctok.type = tk_string; 
+      s->ctok.l = i + 1;
+      s->ptr += (i + 1);
+      return;
+    } break;
+    default: {
+      if( hl_isalpha(p[x]) ){
+        unsigned l = 1;
+        while( x + l < n && (hl_isalpha(p[x + l]) || hl_isdigit(p[x + l]) || p[x + l] == '_') ) l++;
+        s->ctok.l = l;
+        if( !isreserved(s, p + x, l) ){
+          s->ctok.type = tk_name; /* name tok */
+          s->ctok.value.id = hl_intern(s, p + x, l);
+          s->ptr += l;
+        }
+      } else if( hl_isdigit(p[x]) ){
+        pnumber(s, p, x, n);
+      } else break; /* no token starts with this byte */
+    } return;
+  }
+  s->error = 1;
+  if( !s->lquiet ) fprintf(stderr, "unexpected %c\n", p[x]);
+}
+
+int hl_lnext( hlState_t* s ){
+  next(s);
+  if( s->error ) return -1;
+  return s->ctok.type != tk_eof;
+}
+
+/* grow the token arrays of t to hold n tokens, 0 on failure */
+static int hl_tgrow( hlTokens_t* t, int n ){
+  void* b;
+  n = n > 2 * t->s ? n : 2 * t->s;
+  if( !(b = realloc(t->type, n)) ) return 0;
+  t->type = b;
+  if( !(b = realloc(t->off, n * sizeof(int))) ) return 0;
+  t->off = b;
+  if( !(b = realloc(t->len, n * sizeof(int))) ) return 0;
+  t->len = b;
+  if( !(b = realloc(t->lit, n * sizeof(int))) ) return 0;
+  t->lit = b;
+  t->s = n;
+  return 1;
+}
+
+/* append s->ctok to t, 0 on failure */
+static int hl_tpush( hlState_t* s, hlTokens_t* t ){
+  int i;
+  if( t->n == t->s && !hl_tgrow(t, 1024) ){
+    hl_error(s, "malloc failure\n", NULL);
+    return 0;
+  }
+  i = t->n++;
+  t->type[i] = s->ctok.type;
+  t->off[i] = s->ctok.off;
+  t->len[i] = s->ctok.l;
+  t->lit[i] = 0;
+  if( s->ctok.type == tk_name || s->ctok.type == tk_string ){
+    t->lit[i] = s->ctok.value.id;
+  } else if( s->ctok.type == tk_boolean ){
+    t->lit[i] = s->ctok.value.number != 0;
+  } else if( s->ctok.type == tk_number ){
+    if( t->nn == t->ns ){
+      hlNum_t* b = realloc(t->num, (t->ns ? 2 * t->ns : 256) * sizeof(hlNum_t));
+      if( !b ){
+        hl_error(s, "malloc failure\n", NULL);
+        return 0;
+      }
+      t->num = b;
+      t->ns = t->ns ? 2 * t->ns : 256;
+    }
+    t->num[t->nn] = s->ctok.value.number;
+    t->lit[i] = t->nn++;
+  }
+  return 1;
+}
+
+/* 
+ * lex all of s->prog into t, the parser then reads t once it is set
+ * in s->toks. Returns the number of tokens, -1 on errors 
+ */
+int hl_lall( hlState_t* s, hlTokens_t* t ){
+  hlTokens_t* toks = s->toks;
+  memset(t, 0, sizeof(hlTokens_t));
+  s->toks = NULL;
+  s->ptr = 0;
+  do {
+    next(s);
+  } while( !s->error && hl_tpush(s, t) && s->ctok.type != tk_eof );
+  s->toks = toks;
+  s->ctok.type = -1;
+  s->tp = 0;
+  return s->error ? -1 : t->n;
+}
+
+void hl_tfree( hlTokens_t* t ){
+  free(t->type);
+  free(t->off);
+  free(t->len);
+  free(t->lit);
+  free(t->num);
+  memset(t, 0, sizeof(hlTokens_t));
+}
+
+/*
+ * hl_lpar cuts prog at lines that start a top level statement and lexes
+ * the pieces on threads, each interning into a state of its own. Whether
+ * a piece begins inside a comment or string depends on all of prog
+ * before it, so first each piece is scanned for strings and comments
+ * from each state a line can start in, which gives the state every
+ * piece starts in one after another. A piece then skips the rest of the
+ * string or comment it starts in before lexing.
+ *
+ * Lexing restarts at any token start, so the join lexes on from the end
+ * of the tokens so far until it reaches a token start the piece has as
+ * well, and takes the rest of the piece from there. That is a token a
+ * piece, more only where the scan and the lexer disagree. The taken
+ * tokens are then copied into place on the threads again.
+ */
+
+#define HL_LCHUNK   65536 /* smallest piece lexed on its own */
+#define HL_LTHREADS 64
+
+typedef struct {
+  hlState_t  s; /* prog, pend and the strings of the piece */
+  hlTokens_t t;
+  int        from;
+  int        to; /* the tokens starting in from..to-1 */
+  int        st; /* the state from is in */
+  int        out[4]; /* the state to is in, by the state from is in */
+  int        end; /* after the last token */
+  int        sc; /* ids interned by the tokens */
+  int*       m; /* ids in the joined state, once taken */
+  int        j; /* first token and number taken */
+  int        nj;
+  int        at; /* where they go in the joined arrays */
+  int        nat;
+} hlLexChunk_t;
+
+/* the states a line starts in */
+enum { HL_LCODE, HL_LDQ, HL_LSQ, HL_LBLOCK };
+
+static const unsigned char hlLexOpen[4] = { '"', '\'', '-', '/' };
+
+/* 
+ * the state at x after p[i..x-1] from state m, following strings and 
+ * comments the way next() does. x starts a line, nothing else spans it 
+ */
+static int hl_lstate( unsigned char* p, int i, int x, int m, int n ){
+  while( i < x ){
+    switch( m ){
+      case HL_LCODE:
+        if( (i = hl_lscan(p, i, x, hlLexOpen, 1)) >= x ) break;
+        if( p[i] == '"' ) m = HL_LDQ;
+        else if( p[i] == '\'' ) m = HL_LSQ;
+        else if( i + 1 < n && p[i + 1] == '-' ){
+          /* a block comment is scanned from the - of its /- */
+          if( p[i] == '-' ) i = hl_lscan(p, i + 2, x, hlLexLine, 1) - 1;
+          else m = HL_LBLOCK;
+        }
+        i++;
+        break;
+      case HL_LDQ:
+      case HL_LSQ:
+        if( (i = hl_lscan(p, i, x, m == HL_LDQ ? hlLexDq : hlLexSq, 1)) >= x ) break;
+        if( p[i] == '\\' ) i += 2;
+        else {
+          m = HL_LCODE;
+          i++;
+        }
+        break;
+      default:
+        if( (i = hl_lscan(p, i, x, hlLexDash, 1)) >= x ) break;
+        if( i + 1 < n && p[i + 1] == '/' ){
+          m = HL_LCODE;
+          i += 2;
+        } else i++;
+        break;
+    }
+  }
+  return m;
+}
+
+/* after the string or comment i is in, in state m */
+static int hl_lskip( unsigned char* p, int i, int m, int n ){
+  if( m == HL_LBLOCK ){
+    for( ; (i = hl_lscan(p, i, n, hlLexDash, 1)) + 1 < n && p[i + 1] != '/'; i++ );
+    return i + 1 < n ? i + 2 : n;
   }
-  (*i)++;
-  return c;
+  if( m != HL_LCODE ){
+    for( ; (i = hl_lscan(p, i, n, m == HL_LDQ ? hlLexDq : hlLexSq, 1)) < n && p[i] == '\\'; i += 2 );
+    return i < n ? i + 1 : n;
+  }
+  return i;
 }
 
-static unsigned char* pstring( hlState_t* s, unsigned char* v, int l ){
-  int i = 0, j = 0;
-  unsigned char c, e;
-  unsigned char* b = hl_malloc(s, l + 1);
-  if( !b ) return NULL;
-  while( i < l ){
-    c = v[i++];
-    if( c == '\\' ){
-      e = pesc(v + i, &i);
-      if( e ) b[j++] = e;
-    } else {
-      b[j++] = c;
-    }
+/* the first line at or after x that starts with a name, n if none */
+static int hl_lsplit( unsigned char* p, int x, int n ){
+  for( ; x < n; x++ ){
+    if( p[x - 1] == '\n' && hl_isalpha(p[x]) ) return x;
   }
-  return b;
+  return n;
 }
 
-static unsigned char* pname( hlState_t* s, unsigned char* v ){
-  int i = 0;
-  unsigned char* b;
-  while(
-    hl_isalpha(*(v + i)) ||
-    hl_isdigit(*(v + i)) ||
-    (*(v + i) == '_') 
-  ) i++;
-  b = hl_malloc(s, i + 1);
-  if( !b ) return NULL;
-  memcpy(b, v, i);
-  return b;
+static void hl_lfork( hlState_t* s, hlLexChunk_t* c, int from ){
+  memset(c, 0, sizeof(hlLexChunk_t));
+  c->s.prog = s->prog;
+  c->s.pend = s->pend;
+  c->s.lquiet = 1;
+  c->s.ctok.type = -1;
+  c->s.names = hl_hinit(&c->s);
+  hl_intern(&c->s, (unsigned char *)"", 0);
+  c->from = from;
+}
+
+static void hl_lunfork( hlLexChunk_t* c ){
+  hl_hfree(&c->s.names);
+  free(c->s.strs);
+  free(c->m);
+  hl_afree(&c->s.sa);
+  hl_tfree(&c->t);
 }
 
-static int pow( int b, int e ){
-  int r = 1;
-  while( e ){
-    if( e & 1 ) r *= b;
-    e >>= 1;
-    b *= b;
+static void hl_lstates( hlLexChunk_t* c, hlTokens_t* t ){
+  int m;
+  (void)t;
+  for( m = HL_LCODE; m <= HL_LBLOCK; m++ ) 
+    c->out[m] = hl_lstate(c->s.prog, c->from, c->to, m, c->s.pend - c->s.prog);
+}
+
+/* lex the tokens of a piece, stopping quietly at the first error */
+static void hl_lchunk( hlLexChunk_t* c, hlTokens_t* t ){
+  hlState_t* s = &c->s;
+  (void)t;
+  c->from = hl_lskip(s->prog, c->from, c->st, s->pend - s->prog);
+  s->ptr = c->end = c->from;
+  for( ;; ){
+    next(s);
+    if( s->error || (s->ctok.off >= c->to && s->ctok.type != tk_eof) ) break;
+    if( !hl_tpush(s, &c->t) ) break;
+    c->end = s->ptr;
+    c->sc = s->sc;
+    if( s->ctok.type == tk_eof ) break;
   }
-  return r;
 }
 
-static void pnumber( hlState_t* s, unsigned char* p, int x ){
-  int i = 0, df = 0, dc = 0;
-  unsigned char c;
-  hlNum_t r = 0.0f, dec = 0.0f;
-  while( 
-    (c = p[x + i]) &&
-    (hl_isdigit(c) || (c == '.' && !df))
-  ){
-    if( c == '.' ) df = 1;
-    else {
-      if( !df ) r = r * 10 + (c - '0');
-      else {
-        dc++;
-        dec = dec * 10 + (c - '0');
-      }
+/* copy the tokens taken from a piece into t */
+static void hl_lcopy( hlLexChunk_t* c, hlTokens_t* t ){
+  hlTokens_t* u = &c->t;
+  int i, x, n = u->n - c->j;
+  if( !c->m ) return;
+  memcpy(t->type + c->at, u->type + c->j, n);
+  memcpy(t->off + c->at, u->off + c->j, n * sizeof(int));
+  memcpy(t->len + c->at, u->len + c->j, n * sizeof(int));
+  if( u->nn > c->nj ) memcpy(t->num + c->nat, u->num + c->nj, (u->nn - c->nj) * sizeof(hlNum_t));
+  for( i = 0; i < n; i++ ){
+    x = u->lit[c->j + i];
+    switch( u->type[c->j + i] ){
+      case tk_name:
+      case tk_string: x = c->m[x]; break;
+      case tk_number: x += c->nat - c->nj; break;
     }
-    i++;  
-  }
-  if( dec ){
-    dec /= pow(10, dc);
-    r += dec;
+    t->lit[c->at + i] = x;
   }
-  s->ctok.value.number = r;
-  s->ptr += i;
-  s->ctok.type = tk_number;
 }
 
-static int isreserved( hlState_t* s, unsigned char* str, unsigned l ){
+#ifdef HL_PTHREADS
+typedef struct {
+  hlLexChunk_t*   c;
+  int             n;
+  int             next; /* the next piece */
+  void            (*fn)( hlLexChunk_t*, hlTokens_t* );
+  hlTokens_t*     t;
+  pthread_mutex_t lk;
+} hlLexPool_t;
+
+static void* hl_lwork( void* a ){
+  hlLexPool_t* p = a;
   int i;
-  for( i = tkSymCnt; i < tkCnt; i++ ){
-    if( 
-      l != strlen(hlTkns[i]) || 
-      !hl_ismatch(str, hlTkns[i], l) 
-    ) continue;
-    if( i == tk_true || i == tk_false ){
-      s->ctok.type = tk_boolean; 
-      s->ctok.value.number = (i == tk_true); 
-    } else {
-      s->ctok.type = i;
-    }
-    s->ptr += l;
-    return 1;
+  for( ;; ){
+    pthread_mutex_lock(&p->lk);
+    i = p->next++;
+    pthread_mutex_unlock(&p->lk);
+    if( i >= p->n ) return NULL;
+    p->fn(p->c + i, p->t);
   }
-  return 0;
 }
+#endif
 
-static void next( hlState_t* s ){
-  int i, x;
-  unsigned char* p = s->prog;
-  hl_eabort(s);
-check_comments:
-  while( hl_isspace(p[s->ptr]) ) s->ptr++; 
+/* fn on each of the n pieces in c, on up to w threads */
+static void hl_lrun( 
+  hlLexChunk_t* c, int n, int w, void (*fn)( hlLexChunk_t*, hlTokens_t* ), hlTokens_t* t 
+){
+#ifdef HL_PTHREADS
+  pthread_t tid[HL_LTHREADS];
+  hlLexPool_t p;
+  int r = 0;
+  p.c = c;
+  p.n = n;
+  p.next = 0;
+  p.fn = fn;
+  p.t = t;
+  pthread_mutex_init(&p.lk, NULL);
+  while( r < w - 1 && r < n - 1 && !pthread_create(tid + r, NULL, hl_lwork, &p) ) r++;
+  hl_lwork(&p);
+  while( r-- ) pthread_join(tid[r], NULL);
+  pthread_mutex_destroy(&p.lk);
+#else
+  int i;
+  (void)w;
+  for( i = 0; i < n; i++ ) fn(c + i, t);
+#endif
+}
 
-  /* inline comments start with -- */
-  if( hl_ismatch(p + s->ptr, "--", 2) ){
-    s->ptr += 2;
-    while( p[s->ptr] != '\n' && p[s->ptr] !='\r' && p[s->ptr] != 0 ) s->ptr++; 
-    goto check_comments; 
+/* make room for n more tokens and nn more numbers in t */
+static int hl_treserve( hlState_t* s, hlTokens_t* t, int n, int nn ){
+  if( t->n + n > t->s && !hl_tgrow(t, t->n + n) ){
+    hl_error(s, "malloc failure\n", NULL);
+    return 0;
   }
-   /* block comments start with /- and end with -/ */
-  if( hl_ismatch(p + s->ptr, "/-", 2) ){
-    while( !hl_ismatch(p + s->ptr, "-/", 2) && p[s->ptr] != 0 ) s->ptr++; 
-    s->ptr += 2;
-    goto check_comments;
+  if( t->nn + nn > t->ns ){
+    hlNum_t* b = realloc(t->num, (t->nn + nn > 2 * t->ns ? t->nn + nn : 2 * t->ns) * sizeof(hlNum_t));
+    if( !b ){
+      hl_error(s, "malloc failure\n", NULL);
+      return 0;
+    }
+    t->num = b;
+    t->ns = t->nn + nn > 2 * t->ns ? t->nn + nn : 2 * t->ns;
   }
+  return 1;
+}
 
-  x = s->ptr;
-  if( !p[x] ){
-    s->ctok.type = tk_eof;
+/* 
+ * take the tokens of c from j on, interning their ids in the order 
+ * hl_lall would and keeping space for hl_lcopy. Ids of a whole piece 
+ * are in the order they were first seen already 
+ */
+static void hl_ltake( hlState_t* s, hlTokens_t* t, hlLexChunk_t* c, int j ){
+  hlTokens_t* u = &c->t;
+  int i, x;
+  if( !(c->m = malloc(c->sc * sizeof(int))) ){
+    hl_error(s, "malloc failure\n", NULL);
     return;
   }
-  /* check for symbols */
-  for( i = 0; i < tkSymCnt; i++ ){
-    int l = strlen(hlTkns[i]);
-    if( hl_ismatch(p + x, hlTkns[i], l) ){
-      s->ctok.type = i;
-      s->ptr += l;
-      return;
+  c->j = j;
+  c->nj = j ? u->nn : 0;
+  if( !j ){
+    for( i = 0; i < c->sc; i++ ) c->m[i] = hl_intern(s, c->s.strs[i]->data, c->s.strs[i]->l);
+  } else {
+    memset(c->m, 0xff, c->sc * sizeof(int));
+    for( i = j; i < u->n; i++ ){
+      x = u->lit[i];
+      if( (u->type[i] == tk_name || u->type[i] == tk_string) && c->m[x] < 0 ){
+        c->m[x] = hl_intern(s, c->s.strs[x]->data, c->s.strs[x]->l);
+      } else if( u->type[i] == tk_number && x < c->nj ) c->nj = x;
     }
   }
-  switch( p[x] ){
-    case 0:
-      s->ctok.type = 0;
-      return;
-    case '\'':
-    case '"': {
-      int i = 1;
-      char end = p[x];
-      unsigned char c, *str;
-      while( 
-        (c = p[x + i]) &&
-        (c != end || p[x + i - 1] == '\\')
-      ) i++;
-      if( !c ){
-        s->error = 1;
-        return;
-      }
-      str = pstring(s, p + x + 1, i - 1);
-      if( str ){
-        s->ctok.type = tk_string; 
-        s->ctok.value.data = str;
-        s->ctok.l = i - 1;
-        s->ptr += (i + 1);
-      }
-      return;
-    } break;
-    default: {
-      if( hl_isalpha(p[x]) ){
-        unsigned char* str;
-        unsigned l = 0;
-        s->ctok.type = tk_name; /* name tok */
-        str = pname(s, p + x);
-        if( !str ){
-          /* some error happened */
-          return;
-        }
-        l = strlen((const char *)str);
-        if( !isreserved(s, str, l) ){
-          s->ctok.value.data = str;
-          s->ptr += l;
-          s->ctok.l = l;
-        }
-      } else if( hl_isdigit(p[x]) ){
-        pnumber(s, p, x);
+  if( !hl_treserve(s, t, u->n - j, u->nn - c->nj) ) return;
+  c->at = t->n;
+  c->nat = t->nn;
+  t->n += u->n - j;
+  t->nn += u->nn - c->nj;
+}
+
+/* 
+ * hl_lall on up to w threads, the same tokens and ids. Without
+ * HL_PTHREADS the pieces are lexed one after another 
+ */
+int hl_lpar( hlState_t* s, hlTokens_t* t, int w ){
+  hlTokens_t* toks = s->toks;
+  hlLexChunk_t* c;
+  int i, j, k, m, n, at = 0, eof = 0;
+  if( !s->pend ) s->pend = s->prog + strlen((const char *)s->prog);
+  n = s->pend - s->prog;
+  w = w < HL_LTHREADS ? w : HL_LTHREADS;
+  /* a few pieces a thread, so one slow piece does not hold up the rest */
+  m = 4 * w < n / HL_LCHUNK ? 4 * w : n / HL_LCHUNK;
+  if( w < 2 || m < 2 || !(c = malloc(m * sizeof(hlLexChunk_t))) ) return hl_lall(s, t);
+  for( i = k = 0; i < m; i++ ){
+    int x = i ? hl_lsplit(s->prog, (long)n * i / m, n) : 0;
+    if( k && (x <= c[k - 1].from || x == n) ) continue;
+    hl_lfork(s, c + k, x);
+    if( k ) c[k - 1].to = x;
+    k++;
+  }
+  c[k - 1].to = n;
+  hl_lrun(c, k, w, hl_lstates, NULL);
+  for( i = 1; i < k; i++ ) c[i].st = c[i - 1].out[c[i - 1].st];
+  hl_lrun(c, k, w, hl_lchunk, NULL);
+  memset(t, 0, sizeof(hlTokens_t));
+  s->toks = NULL;
+  /* room for every piece up front, the copies touch it first */
+  for( i = j = m = 0; i < k; i++ ){
+    j += c[i].t.n;
+    m += c[i].t.nn;
+  }
+  hl_treserve(s, t, j, m);
+  for( i = 0; i < k && !s->error && !eof; i++ ){
+    hlTokens_t* u = &c[i].t;
+    for( j = 0; ; ){
+      while( j < u->n && u->off[j] < at ) j++;
+      if( j == u->n ) break;
+      s->ptr = at;
+      next(s);
+      if( s->error ) break;
+      if( s->ctok.off == u->off[j] ){
+        hl_ltake(s, t, c + i, j);
+        at = c[i].end;
+        eof = u->type[u->n - 1] == tk_eof;
+        break;
       }
-    } return;
+      if( !hl_tpush(s, t) || (eof = s->ctok.type == tk_eof) ) break;
+      at = s->ptr;
+    }
   }
-  s->error = 1;
-  fprintf(stderr, "unexpected %c\n", p[x]);
+  /* the rest, if the last piece stopped at an error */
+  s->ptr = at;
+  while( !s->error && !eof ){
+    next(s);
+    if( !s->error && hl_tpush(s, t) ) eof = s->ctok.type == tk_eof;
+  }
+  if( !s->error ) hl_lrun(c, k, w, hl_lcopy, t);
+  for( i = 0; i < k; i++ ) hl_lunfork(c + i);
+  free(c);
+  s->toks = toks;
+  s->ctok.type = -1;
+  s->tp = 0;
+  return s->error ? -1 : t->n;
 }
 
 static int peek( hlState_t* s, token t ){
@@ -576,53 +3414,133 @@ static void namelist( hlState_t* );
 static void expressionlist( hlState_t* );
 static void expression( hlState_t* );
 static void ifstatement( hlState_t* );
-static void elsestatement( hlState_t* );
+static void elsestatement( hlState_t*, int );
 static void statementlist( hlState_t* );
 static void valuesuffix( hlState_t* );
 static void statement( hlState_t* );
 
-static int unop( hlState_t* s ){
-  token tok = s->ctok.type;
-  return tok == tk_not ||
-    tok == tk_lnot     ||
-    tok == tk_band     ||
-    tok == tk_ast;
-}
-
-static int assignment( hlState_t* s ){
-  token tok = s->ctok.type;
-  return tok == tk_oeq ||
-    tok == tk_meq      ||
-    tok == tk_peq      ||
-    tok == tk_teq      ||
-    tok == tk_xeq      ||
-    tok == tk_deq      ||
-    tok == tk_modeq    ||
-    tok == tk_rseq     ||
-    tok == tk_lseq     ||
-    tok == tk_eq       ||
-    tok == tk_aeq;
-}
-
-static int binop( hlState_t* s ){
-  token tok = s->ctok.type;
-  return tok == tk_land ||
-    tok == tk_lor       ||
-    tok == tk_ls        ||
-    tok == tk_rs        ||
-    tok == tk_bor       ||
-    tok == tk_sub       ||
-    tok == tk_add       ||
-    tok == tk_xor       ||
-    tok == tk_div       ||
-    tok == tk_mod       ||
-    tok == tk_gt        ||
-    tok == tk_lt        ||
-    tok == tk_band      ||
-    tok == tk_ast       ||
-    tok == tk_leq       ||
-    tok == tk_geq       ||
-    tok == tk_iseq;
+/* 1 if ctok is a unary operator, op is its opcode or -1 if it has none */
+static int unop( hlState_t* s, int* op ){
+  switch( s->ctok.type ){
+    case tk_not:  *op = OP_NOT; return 1;
+    case tk_lnot: *op = OP_BNOT; return 1;
+    case tk_sub:  *op = OP_NEG; return 1;
+    case tk_ast:  *op = -1; return 1; /* weak references, not in the vm yet */
+    default: return 0;
+  }
+}
+
+/* 1 if ctok is an assignment, op is the opcode it applies or -1 for = */
+static int assignment( hlState_t* s, int* op ){
+  switch( s->ctok.type ){
+    case tk_eq:    *op = -1; return 1;
+    case tk_oeq:   *op = OP_BOR; return 1;
+    case tk_meq:   *op = OP_SUB; return 1;
+    case tk_peq:   *op = OP_ADD; return 1;
+    case tk_teq:   *op = OP_MULT; return 1;
+    case tk_xeq:   *op = OP_XOR; return 1;
+    case tk_deq:   *op = OP_DIV; return 1;
+    case tk_modeq: *op = OP_MOD; return 1;
+    case tk_rseq:  *op = OP_RSHIFT; return 1;
+    case tk_lseq:  *op = OP_LSHIFT; return 1;
+    case tk_aeq:   *op = OP_BAND; return 1;
+    default: return 0;
+  }
+}
+
+/* 
+ * the precedence of ctok if it is a binary operator, else 0, and its 
+ * opcode in op. Higher binds tighter, all are left associative
+ */
+static int binop( hlState_t* s, int* op ){
+  switch( s->ctok.type ){
+    case tk_lor:  *op = OP_LOR; return 1;
+    case tk_land: *op = OP_LAND; return 2;
+    case tk_lt:   *op = OP_LT; return 3;
+    case tk_gt:   *op = OP_GT; return 3;
+    case tk_leq:  *op = OP_LEQ; return 3;
+    case tk_geq:  *op = OP_GEQ; return 3;
+    case tk_iseq: *op = OP_ISEQ; return 3;
+    case tk_neq:  *op = OP_NEQ; return 3;
+    case tk_bor:  *op = OP_BOR; return 4;
+    case tk_xor:  *op = OP_XOR; return 5;
+    case tk_band: *op = OP_BAND; return 6;
+    case tk_ls:   *op = OP_LSHIFT; return 7;
+    case tk_rs:   *op = OP_RSHIFT; return 7;
+    case tk_add:  *op = OP_ADD; return 8;
+    case tk_sub:  *op = OP_SUB; return 8;
+    case tk_ast:  *op = OP_MULT; return 9;
+    case tk_div:  *op = OP_DIV; return 9;
+    case tk_mod:  *op = OP_MOD; return 9;
+    default: return 0;
+  }
+}
+
+#define HL_PUNARY 10 /* tighter than any binary operator */
+
+/* 
+ * Variables. Locals live in slots of their function, found at compile
+ * time, and those of enclosing functions are reached through env. Only
+ * names declared at the top level, globals, are looked up by name
+ */
+
+#define HL_UPMAX 0xff /* envs out OP_GETUPVAL reaches */
+
+/* the slot of the local id in f from the var from on, -1 if it has none */
+static int localslot( hlFunc_t* f, int id, int from ){
+  int i = f->vc;
+  while( i-- > from ) if( f->vars[i] == id ) return i;
+  return -1;
+}
+
+/* a slot for id in the current function */
+static int newlocal( hlState_t* s, int id ){
+  hlFunc_t* f = s->fs;
+  hl_eabortr(s, 0);
+  if( localslot(f, id, f->vb) != -1 ){
+    hl_error(s, "already declared", (char *)s->strs[id]->data);
+    return 0;
+  }
+  if( f->vc == f->vs ){
+    int n = f->vs ? 2 * f->vs : 8;
+    int* b = realloc(f->vars, n * sizeof(int));
+    if( !b ){
+      hl_error(s, "malloc failure\n", NULL);
+      return 0;
+    }
+    f->vars = b;
+    f->vs = n;
+  }
+  f->vars[f->vc] = id;
+  if( f->vc == f->sc ) f->sc++;
+  return f->vc++;
+}
+
+/* declare id with the value on the stack */
+static void declare( hlState_t* s, int id ){
+  if( s->fs == s->global && !s->fs->nest ){
+    ipush(s, OP_NLOCAL, vpushstr(s, id));
+  } else {
+    ipush(s, OP_SETLOCAL, newlocal(s, id));
+  }
+}
+
+/* push id, or set it to the value popped */
+static void variable( hlState_t* s, int id, int set ){
+  hlFunc_t* f = s->fs;
+  int i, d = 0;
+  for( ; f; f = f->env, d++ ){
+    if( (i = localslot(f, id, 0)) == -1 ) continue;
+    if( !d ){
+      ipush(s, set ? OP_SETLOCAL : OP_GETLOCAL, i);
+    } else if( d > HL_UPMAX ){
+      hl_error(s, "too deeply nested to reach", (char *)s->strs[id]->data);
+    } else {
+      ipush(s, set ? OP_SETUPVAL : OP_GETUPVAL, (i << 8) | d);
+    }
+    return;
+  }
+  ipush(s, set ? OP_SLOCAL : OP_GLOCAL, vpushstr(s, id));
 }
 
 /*
@@ -630,19 +3548,46 @@ block ::=
   `{` statementlist `}`
 */
 
-static void block( hlState_t* s ){
-  int i;
-  hlFunc_t* state = s->fs;
-  hlFunc_t* b = funcstate(s);
-  b->env = state;
-  hl_eabort(s);
-  s->fs = b;
+static void body( hlState_t* s ){
   expect(s, tk_lbrc);
   statementlist(s);
   expect(s, tk_rbrc);
-  s->fs = state;
-  i = vpushfunc(s, b);
-  ipush(s, OP_PUSHVAL, i);
+}
+
+/* compile into a new function in the current one */
+static hlFunc_t* funcbegin( hlState_t* s ){
+  hlFunc_t* b = funcstate(s);
+  if( !b ) return NULL;
+  b->env = s->fs;
+  s->fs = b;
+  return b;
+}
+
+/* back to the function around b, which pushes it */
+static void funcend( hlState_t* s, hlFunc_t* b ){
+  funcdone(s, b);
+  s->fs = b->env;
+  ipush(s, OP_PUSHVAL, vpushfunc(s, b));
+}
+
+/* 
+ * the body of an if, else, while or for, a block or one statement. 
+ * It is inline in the current function and its locals end with it 
+ */
+static void scope( hlState_t* s ){
+  hlFunc_t* f = s->fs;
+  int vb = f->vb, vc = f->vc;
+  hl_eabort(s);
+  f->vb = vc;
+  f->nest++;
+  if( peek(s, tk_lbrc) ){
+    body(s);
+  } else {
+    statement(s);
+  }
+  f->nest--;
+  f->vb = vb;
+  f->vc = vc;
 }
 
 /*
@@ -681,8 +3626,9 @@ name ::=
   Name typehint
 */
 
-static void name( hlState_t* s ){
-  hl_eabort(s);
+static int name( hlState_t* s ){
+  int id = s->ctok.value.id;
+  hl_eabortr(s, 0);
   expect(s, tk_name);
   if( accept(s, tk_col) ){
     if( accept(s, tk_str)      ||   
@@ -691,14 +3637,15 @@ static void name( hlState_t* s ){
         accept(s, tk_function) ||
         accept(s, tk_Nil)      ||
         accept(s, tk_bool)){
-      return;
+      return id;
     } else if( accept(s, tk_name) ){
       /* make sure Name corresponds to a declared struct type */
-      return;
+      return id;
     } else {
       hl_error(s, "expected", "type declaration");
     }
   };
+  return id;
 }
 
 
@@ -709,10 +3656,11 @@ namelist ::=
   nil
 */
 
+/* parameters, the first slots of the function */
 static void namelist( hlState_t* s ){
 name_list:
   hl_eabort(s);
-  name(s);
+  newlocal(s, name(s));
   if( accept(s, tk_com) ){
     goto name_list;
   }
@@ -725,14 +3673,17 @@ lambda ::=
 */
 
 static void lambda( hlState_t* s ){
+  hlFunc_t* b;
   hl_eabort(s);
   expect(s, tk_fn);
+  if( !(b = funcbegin(s)) ) return;
   namelist(s);
   if( accept(s, tk_arrow) ){
     expression(s);
   } else {
-    block(s);
+    body(s);
   }
+  funcend(s, b);
 }
 
 
@@ -751,15 +3702,68 @@ static void value( hlState_t* s ){
   } else if( peek(s, tk_fn) ){
     lambda(s);
   } else {
-    int i, l = s->ctok.l;
-    unsigned char* n = s->ctok.value.data;
+    int id = s->ctok.value.id;
     expect(s, tk_name);
-    i = vpushstr(s, n, l);
-    ipush(s, OP_GLOCAL, i);
+    variable(s, id, 0);
     valuesuffix(s);
   }
 }
 
+/* 
+ * an expression being compiled. A constant is held back until an 
+ * operator needs it pushed, so operators on constants fold 
+ */
+typedef struct {
+  int       k; /* v is a constant not pushed yet */
+  hlValue_t v;
+} hlExpr_t;
+
+static void exprpush( hlState_t* s, hlExpr_t* e ){
+  if( e->k ) ipush(s, OP_PUSHVAL, vpushval(s, e->v));
+  e->k = 0;
+}
+
+/* 
+ * push e ahead of the code from ip on, which the right operand of e
+ * compiled to. Expressions hold no jumps, so that code can move
+ */
+static void exprinsert( hlState_t* s, hlExpr_t* e, int ip ){
+  hlFunc_t* f = s->fs;
+  unsigned in[32 / HL_ARGBITS + 1]; /* the push and its prefixes */
+  int n = f->ip;
+  exprpush(s, e);
+  if( (n = f->ip - n) < 1 ) return;
+  memcpy(in, f->ins + f->ip - n, n * sizeof(unsigned));
+  memmove(f->ins + ip + n, f->ins + ip, (f->ip - n - ip) * sizeof(unsigned));
+  memcpy(f->ins + ip, in, n * sizeof(unsigned));
+}
+
+/* 
+ * l op r into l if op takes both constants, r is NULL for unary 
+ * operators. 0 if it would fail at runtime, which is left to report it
+ */
+static int fold( int op, hlValue_t* l, hlValue_t* r ){
+  switch( op ){
+    case OP_ISEQ:
+    case OP_NEQ: l->v.b = hl_vequal(l, r) == (op == OP_ISEQ); break;
+    case OP_LAND: l->v.b = istruthy((*l)) && istruthy((*r)); break;
+    case OP_LOR: l->v.b = istruthy((*l)) || istruthy((*r)); break;
+    case OP_NOT: l->v.b = !istruthy((*l)); break;
+    default:
+      if( l->t != numtype || (r && r->t != numtype) ) return 0;
+      switch( op ){
+        case OP_LT: l->v.b = l->v.n < r->v.n; break;
+        case OP_GT: l->v.b = l->v.n > r->v.n; break;
+        case OP_LEQ: l->v.b = l->v.n <= r->v.n; break;
+        case OP_GEQ: l->v.b = l->v.n >= r->v.n; break;
+        case OP_NEG: l->v.n = -l->v.n; return 1;
+        default: l->v.n = hl_narith(op, l->v.n, r ? r->v.n : 0); return 1;
+      }
+  }
+  l->t = booltype;
+  return 1;
+}
+
 /*
 expression ::=
   literal |
@@ -767,64 +3771,79 @@ expression ::=
   unop expression |
   expression binop expression |
   `(` expression `)` 
+
+by precedence climbing, subexpr takes the operators binding tighter
+than prec
 */
 
-static void expression( hlState_t* s ){
-  /* this doesn't handle precedence yet, 
-     and everything is right assosiative */
+static void subexpr( hlState_t* s, hlExpr_t* e, int prec ){
+  hlExpr_t r;
+  int op = 0, p, ip;
+  e->k = 0;
   hl_eabort(s);
   if( accept(s, tk_string) ){
-    int i = vpushstr(s, s->ctok.value.data, s->ctok.l);
-    ipush(s, OP_PUSHVAL, i);
+    e->k = 1;
+    e->v.t = strtype;
+    e->v.v.s = s->strs[s->ptok.value.id];
   } else if( accept(s, tk_number) ){
-    int i = vpushnum(s, s->ctok.value.number);
-    ipush(s, OP_PUSHVAL, i);
+    e->k = 1;
+    e->v.t = numtype;
+    e->v.v.n = s->ptok.value.number;
   } else if( accept(s, tk_boolean) ){
-    int i = vpushbool(s, s->ctok.value.number);
-    ipush(s, OP_PUSHVAL, i);
+    e->k = 1;
+    e->v.t = booltype;
+    e->v.v.b = s->ptok.value.number != 0;
   } else if( accept(s, tk_nil) ){
-    ipush(s, OP_PUSHVAL, vpushnil(s));
-  } else if( unop(s) ){
+    e->k = 1;
+    e->v.t = niltype;
+    e->v.v.n = 0;
+  } else if( unop(s, &op) ){
     next(s);
-    expression(s);
+    subexpr(s, e, HL_PUNARY);
+    if( op >= 0 && !(e->k && fold(op, &e->v, NULL)) ){
+      exprpush(s, e);
+      ipush(s, op, 0);
+    }
   } else if( accept(s, tk_lp) ){
-    expression(s);
+    subexpr(s, e, 0);
     expect(s, tk_rp);
   } else if( accept(s, tk_new) ){
+    /* objects are not in the vm yet, a new one is nil */
+    e->k = 1;
+    e->v.t = niltype;
+    e->v.v.n = 0;
     expect(s, tk_name);
     if( accept(s, tk_lbrc) ){
       if( accept(s, tk_rbrc) ){
         return;
       }
-      expressionlist(s);
+      do {
+        expression(s);
+        ipush(s, OP_POP, 0);
+      } while( accept(s, tk_com) );
       expect(s, tk_rbrc);
       return;
     }
   } else {
     value(s);
   }
-  if( binop(s) ){
-    int op = 0;
-    switch( s->ctok.type ){
-      case tk_sub:  op = OP_SUB; break;
-      case tk_add:  op = OP_ADD; break;
-      case tk_div:  op = OP_DIV; break;
-      case tk_ast:  op = OP_MULT; break;
-      case tk_leq:  op = OP_LEQ; break;
-      case tk_geq:  op = OP_GEQ; break;
-      case tk_iseq: op = OP_ISEQ; break;
-      case tk_land: op = OP_LAND; break;
-      case tk_lor:  op = OP_LOR; break;
-      case tk_gt:   op = OP_GT; break;
-      case tk_lt:   op = OP_LT; break;
-      default: break;
-    }
+  while( (p = binop(s, &op)) > prec ){
     next(s);
-    expression(s);
+    ip = s->fs->ip;
+    subexpr(s, &r, p);
+    if( e->k && r.k && fold(op, &e->v, &r.v) ) continue;
+    if( e->k ) exprinsert(s, e, ip);
+    exprpush(s, &r);
     ipush(s, op, 0);
   }
 }
 
+static void expression( hlState_t* s ){
+  hlExpr_t e;
+  subexpr(s, &e, 0);
+  exprpush(s, &e);
+}
+
 /*
 valuesuffix ::=
   `.` Name `(` expressionlist `)` valuesuffix |
@@ -875,14 +3894,8 @@ static void ifstatement( hlState_t* s ){
   expression(s);
   ipush(s, OP_JMPF, 0);
   ip = state->ip - 1;
-  if( peek(s, tk_lbrc) ){
-    block(s);
-    ipush(s, OP_CALL, 0);
-  } else {
-    statement(s);
-  }
-  adjustarg(s, ip, state->ip - ip);
-  elsestatement(s);
+  scope(s);
+  elsestatement(s, ip);
 }
 
 /*
@@ -893,21 +3906,18 @@ elsestatement ::=
   nil
 */
 
-static void elsestatement( hlState_t* s ){
-  int ip;
+/* ip is the OP_JMPF of the if, to here or the else part */
+static void elsestatement( hlState_t* s, int ip ){
+  int jmp;
   hlFunc_t* state = s->fs;
   hl_eabort(s);
   if( accept(s, tk_else) ){
-    ipush(s, OP_JMPT, 0);
-    ip = state->ip - 1;
-    if( peek(s, tk_if) ){
-      ifstatement(s);
-    } else if( peek(s, tk_lbrc) ){
-      block(s);
-      ipush(s, OP_CALL, 0);
-    } else {
-      statement(s);
-    }
+    ipush(s, OP_JMP, 0);
+    jmp = state->ip - 1;
+    scope(s);
+    jmp += 1 + adjustarg(s, jmp, state->ip - jmp);
+    adjustarg(s, ip, jmp - ip);
+  } else {
     adjustarg(s, ip, state->ip - ip);
   }
 }
@@ -918,23 +3928,32 @@ whilestatement ::=
   `while` expression statement
 */
 
+/* 
+ * the test is compiled, set aside and put back after the body, so a 
+ * turn runs the body, the test and one OP_LOOP 
+ */
 static void whilestatement( hlState_t* s ){
-  int ip, jmp;
+  int ip, top, c, n;
+  unsigned* test;
   hlFunc_t* state = s->fs;
   hl_eabort(s);
   expect(s, tk_while);
-  jmp = state->ip;
+  c = state->ip;
   expression(s);
-  ipush(s, OP_JMPF, 0);
+  if( !(n = state->ip - c) || !(test = hl_malloc(s, n * sizeof(unsigned))) ) return;
+  memcpy(test, state->ins + c, n * sizeof(unsigned));
+  state->ip = c;
+  ipush(s, OP_JMP, 0);
   ip = state->ip - 1;
-  if( peek(s, tk_lbrc) ){
-    block(s);
-    ipush(s, OP_CALL, 0);
-  } else {
-    statement(s);
+  top = state->ip;
+  scope(s);
+  top += adjustarg(s, ip, state->ip - ip);
+  if( !igrow(s, state, n) ){
+    memcpy(state->ins + state->ip, test, n * sizeof(unsigned));
+    state->ip += n;
+    iback(s, OP_LOOP, top);
   }
-  ipush(s, OP_JMP, jmp);
-  adjustarg(s, ip, state->ip - ip);
+  free(test);
 }
 
 /*
@@ -943,21 +3962,32 @@ forstatement ::=
   `for` Name [ `,` Name ] `in` iterable statement 
 */
 
+/* iterating is not in the vm yet, the body is compiled and skipped */
 static void forstatement( hlState_t* s ){
+  int ip, vb, vc, k, v = -1;
+  hlFunc_t* state = s->fs;
   hl_eabort(s);
   expect(s, tk_for);
+  k = s->ctok.value.id;
   expect(s, tk_name);
   if( accept(s, tk_com) ){
+    v = s->ctok.value.id;
     expect(s, tk_name);
   }
   expect(s, tk_in);
   value(s);
   /* check for spread 0..10 */
-  if( peek(s, tk_lbrc) ){
-    block(s);
-  } else {
-    statement(s);
-  }
+  ipush(s, OP_POP, 0);
+  ipush(s, OP_JMP, 0);
+  ip = state->ip - 1;
+  vb = state->vb;
+  vc = state->vb = state->vc;
+  newlocal(s, k);
+  if( v != -1 ) newlocal(s, v);
+  scope(s);
+  state->vb = vb;
+  state->vc = vc;
+  adjustarg(s, ip, state->ip - ip);
 }
 
 /*
@@ -967,15 +3997,21 @@ functionstatement ::=
 */
 
 static void functionstatement( hlState_t* s ){
+  hlFunc_t* b;
+  int id;
   hl_eabort(s);
   expect(s, tk_fn);
+  id = s->ctok.value.id;
   expect(s, tk_name);
+  if( !(b = funcbegin(s)) ) return;
   namelist(s);
   if( accept(s, tk_arrow) ){
     expression(s);
   } else {
-    block(s);
+    body(s);
   }
+  funcend(s, b);
+  declare(s, id);
 }
 
 /*
@@ -1037,8 +4073,7 @@ static void statement( hlState_t* s ){
   } else if( peek(s, tk_break) ){
     return;
   } else if( accept(s, tk_let) ){
-    int i, l = s->ctok.l;
-    unsigned char* n = s->ctok.value.data;
+    int n = s->ctok.value.id;
     expect(s, tk_name);
     if( s->ctok.type == tk_eq ){
       next(s);
@@ -1046,29 +4081,31 @@ static void statement( hlState_t* s ){
     } else {
       ipush(s, OP_PUSHVAL, vpushnil(s));
     }
-    i = vpushstr(s, n, l);
-    ipush(s, OP_NLOCAL, i);
+    declare(s, n);
   } else if( peek(s, tk_fn) ){
     functionstatement(s);
   } else if( peek(s, tk_struct) ){
     structstatement(s);
   } else if( peek(s, tk_name) ){
-    value(s);
-    /*
-    int i, l = s->ctok.l;
-    unsigned char* n = s->ctok.value.data;
+    int op, n = s->ctok.value.id;
     expect(s, tk_name);
-    */
-    if( assignment(s) ){
+    if( assignment(s, &op) ){
+      next(s);
+      if( op >= 0 ) variable(s, n, 0);
+      expression(s);
+      if( op >= 0 ) ipush(s, op, 0);
+      variable(s, n, 1);
+      return;
+    }
+    variable(s, n, 0);
+    valuesuffix(s);
+    if( assignment(s, &op) ){
+      /* stores through suffixes are not in the vm yet */
       next(s);
       expression(s);
     } else {
       /* must be a functioncall */
     }
-    /*
-    i = vpushstr(s, n, l);
-    ipush(s, OP_SLOCAL, i);
-    */
   } else if( accept(s, tk_log) ){
     expression(s);
     ipush(s, OP_LOG, 0);
@@ -1103,17 +4140,14 @@ void hl_pstart( hlState_t* s ){
   next(s);
   statementlist(s);
   ipush(s, OP_EXIT, 0);
+  funcdone(s, s->fs);
 }
 
 #define pop(x) x->estack[--(x->ep)]
 #define top(x) x->estack[(x->ep)++]
 
-#define getop(x)  x->ins[x->scan] >> 16
-#define getarg(x) x->ins[x->scan] & 0xffff
-
-#define istruthy(x) ((x.t == numtype && x.v.n != 0.0f) \
-   || (x.t == booltype && x.v.b != 0) \
-   || (x.t != niltype && x.t != numtype && x.t != booltype))
+#define getop(x)  (x->ins[x->scan] >> HL_ARGBITS)
+#define getarg(x) (x->ins[x->scan] & HL_ARGMAX)
 
 static hlNum_t popn( hlFunc_t* s ){
   hlValue_t* v = &(pop(s));
@@ -1136,19 +4170,24 @@ static void printstr( hlString_t* str ){
 
 void hl_vrun( hlState_t* s ){
   hlFunc_t* frames[256], *f;
+  unsigned ext = 0; /* from OP_EXTARG */
   int fp = 0;
   f = frames[fp] = s->global;
   hl_eabort(s);
   for( ; ; f->scan++ ){
     int op, arg;
-    if( f->scan >= f->ip ){
+    while( f->scan >= f->ip ){
       if( fp > 0 ){ /* unnest */
         f = frames[--fp];
         f->scan++;
       } else goto exit_vm;
     }
     op = getop(f);
-    arg = getarg(f);
+    arg = ext | getarg(f);
+    ext = 0;
+#ifdef HL_VSTATS
+    s->vins++;
+#endif
     switch( op ){
       case OP_LOG: {
         /* temporary */
@@ -1175,6 +4214,9 @@ void hl_vrun( hlState_t* s ){
             break;
         }
       } break;
+      case OP_EXTARG: {
+        ext = (unsigned)arg << HL_ARGBITS;
+      } break;
       case OP_POP: {
         (f->ep)--;
         /* free resources */
@@ -1182,72 +4224,80 @@ void hl_vrun( hlState_t* s ){
       }
       case OP_CALL: {
         hlFunc_t* b = pop(f).v.f;
+        if( fp + 1 == sizeof(frames) / sizeof(frames[0]) ){
+          s->error = 1;
+          fprintf(stderr, "calls nested too deeply\n");
+          goto exit_vm;
+        }
         f = frames[++fp] = b;
         f->scan = -1; /* this will get incremented */
       } break;
       case OP_JMP: {
-        f->scan = arg;
+        f->scan += arg - 1;
       } break;
       case OP_JMPF: {
         hlValue_t v = pop(f);
         if( !istruthy(v) ) f->scan += arg - 1;
-        f->ep++;
       } break;
       case OP_JMPT: {
         hlValue_t v = pop(f);
         if( istruthy(v) ) f->scan += arg - 1;
-        f->ep++;
+      } break;
+      case OP_LOOP: {
+        hlValue_t v = pop(f);
+        if( istruthy(v) ) f->scan -= arg + 1;
       } break;
       case OP_PUSHVAL: {
-        top(f) = s->vstack[arg];
+        top(f) = f->k[arg];
+      } break;
+      case OP_GETLOCAL: {
+        top(f) = f->slots[arg];
+      } break;
+      case OP_SETLOCAL: {
+        f->slots[arg] = pop(f);
+      } break;
+      case OP_GETUPVAL: {
+        hlFunc_t* e = f;
+        int d = arg & HL_UPMAX;
+        while( d-- ) e = e->env;
+        top(f) = e->slots[arg >> 8];
       } break;
+      case OP_SETUPVAL: {
+        hlFunc_t* e = f;
+        int d = arg & HL_UPMAX;
+        while( d-- ) e = e->env;
+        e->slots[arg >> 8] = pop(f);
+      } break;
+      /* globals, each value is boxed in the table */
       case OP_NLOCAL: {
-        int i;
-        hlValue_t c = s->vstack[arg];
-        hlValue_t v = pop(f);
-        i = hl_hget(&f->locals, c.v.s->data, c.v.s->l);
-        if( i != -1 ){
+        hlValue_t c = f->k[arg];
+        hlValue_t* v, d = pop(f);
+        if( hl_hget(&s->global->locals, c.v.s->data, c.v.s->l) != -1 ){
           s->error = 1;
           fprintf(stderr, "%s already declared\n", c.v.s->data);
-        } else {
-          hl_hset(&f->locals, c.v.s->data, c.v.s->l, &v);
+        } else if( (v = hl_malloc(s, sizeof(hlValue_t))) ){
+          *v = d;
+          hl_hset(&s->global->locals, c.v.s->data, c.v.s->l, v);
         }
       } break;
       case OP_SLOCAL: {
-        int i;
-        hlFunc_t* state = f;
-        hlValue_t c = s->vstack[arg];
-        hlValue_t v = pop(f);
-        while( state ){
-          i = hl_hget(&state->locals, c.v.s->data, c.v.s->l);
-          if( i == -1 ) {
-            state = state->env;
-          } else {
-            hl_hset(&state->locals, c.v.s->data, c.v.s->l, &v);
-            break;
-          }
-        }
+        hlValue_t c = f->k[arg];
+        int i = hl_hget(&s->global->locals, c.v.s->data, c.v.s->l);
         if( i == -1 ){
           s->error = 1;
           fprintf(stderr, "undeclared variable %s\n", c.v.s->data);
+        } else {
+          *(hlValue_t *)hl_hval(&s->global->locals, i) = pop(f);
         }
       } break;
       case OP_GLOCAL: {
-        int i;
-        hlFunc_t* state = f;
-        hlValue_t c = s->vstack[arg];
-        while( state ){
-          i = hl_hget(&state->locals, c.v.s->data, c.v.s->l);
-          if( i == -1 ){
-            state = state->env;
-          } else {
-            top(f) = *(hlValue_t *)(state->locals.t[i].v);
-            break;
-          }
-        }
+        hlValue_t c = f->k[arg];
+        int i = hl_hget(&s->global->locals, c.v.s->data, c.v.s->l);
         if( i == -1 ){
           s->error = 1;
           fprintf(stderr, "undeclared variable %s\n", c.v.s->data);
+        } else {
+          top(f) = *(hlValue_t *)hl_hval(&s->global->locals, i);
         }
       } break;
       case OP_ADD: {
@@ -1310,19 +4360,41 @@ void hl_vrun( hlState_t* s ){
         b.t = booltype;
         top(f) = b;
       } break;
-      case OP_ISEQ: {
+      case OP_ISEQ:
+      case OP_NEQ: {
         hlValue_t r = pop(f);
         hlValue_t l = pop(f);
         hlValue_t b;
         b.t = booltype;
-        if( r.t != l.t ){
-          b.v.b = 0;
-        } else if( r.t == numtype ){
-          b.v.b = r.v.n == l.v.n;
-        } else if( r.t == strtype ){
-          b.v.b = r.v.s->l == l.v.s->l && 
-          !memcmp(r.v.s->data, l.v.s->data, r.v.s->l);
-        }
+        b.v.b = hl_vequal(&l, &r) == (op == OP_ISEQ);
+        top(f) = b;
+      } break;
+      case OP_MOD:
+      case OP_BOR:
+      case OP_BAND:
+      case OP_XOR:
+      case OP_LSHIFT:
+      case OP_RSHIFT: {
+        hlNum_t r = popn(f);
+        hlNum_t l = popn(f);
+        hl_eabort(s);
+        top(f).v.n = hl_narith(op, l, r);
+      } break;
+      case OP_NEG: {
+        hlNum_t n = popn(f);
+        hl_eabort(s);
+        top(f).v.n = -n;
+      } break;
+      case OP_BNOT: {
+        hlNum_t n = popn(f);
+        hl_eabort(s);
+        top(f).v.n = hl_narith(op, n, 0);
+      } break;
+      case OP_NOT: {
+        hlValue_t v = pop(f);
+        hlValue_t b;
+        b.t = booltype;
+        b.v.b = !istruthy(v);
         top(f) = b;
       } break;
       case OP_LAND: {
@@ -21,8 +21,13 @@ void* hl_malloc( hlState_t*, int );
 
 /*
  * Hash Table
- * Quadratic Probing Hash Table
+ * Open addressing with a separate array of one byte control codes.
+ * Probes test HL_HGROUP control bytes at once and only compare keys
+ * whose 7 bit hash tag matches.
  */
+
+#define HL_HGROUP 16 /* control bytes tested per probe */
+#define HL_HSMALL 8  /* entries kept inline before a table is allocated */
  
 typedef struct {
   int      l; /* key length */
@@ -34,12 +39,44 @@ typedef struct {
   void* v; /* value */
 } hlHashEl_t; 
 
+/*
+ * Building with -DHL_HSTATS records what every table does, see
+ * hl_hstats, and totals for the run in the state, see hl_hstatsdump
+ */
+#ifdef HL_HSTATS
+#define HL_HSBINS 16 /* probe length histogram, the last bin holds longer probes */
+
 typedef struct {
-  int         s; /* table size */
-  unsigned    c; /* table count */
-  hlHashEl_t* t;
-  char        f; /* table full */
-  hlState_t*  state; /* compiler state */
+  unsigned long probes[HL_HSBINS]; /* lookups by groups probed, from 1 */
+  unsigned long hits;
+  unsigned long misses; /* hl_hset's own lookup counts too */
+  unsigned long resizes; /* grows, shrinks, purges and spills */
+  double        rtime; /* seconds spent allocating and moving slots */
+  double        rmax; /* longest single resize step in seconds */
+  unsigned long peak; /* most keys held at once */
+  unsigned long tables; /* tables created, run totals only */
+  unsigned long count; /* keys and slots when hl_hstats was called */
+  unsigned long size;
+} hlHashStats_t;
+#endif
+
+typedef struct {
+  int            s; /* table size */
+  unsigned       c; /* table count */
+  unsigned       d; /* tombstones */
+  unsigned char* m; /* control bytes, first HL_HGROUP - 1 mirrored at the end */
+  hlHashEl_t*    t;
+  int            os; /* old table size while resizing */
+  unsigned long  op; /* next old slot to move */
+  unsigned char* om; /* old control bytes, NULL unless resizing */
+  hlHashEl_t*    ot; /* old slots */
+  char           f; /* table full */
+  char           k; /* keyed, hashed with state->seed */
+  hlState_t*     state; /* compiler state */
+  hlHashEl_t     e[HL_HSMALL]; /* entries while t is NULL */
+#ifdef HL_HSTATS
+  hlHashStats_t  st;
+#endif
 } hlHashTable_t;
 
 
@@ -51,11 +88,214 @@ static const int hlhprimes[] = {
 };
 
 
+/*
+ * Building with -DHL_HPOW2 sizes tables in powers of two, indexes 
+ * with a mask and hashes keys a word at a time with hl_hmix 
+ * instead of hl_hsax, so both variants can be compared
+ */
+#ifdef HL_HPOW2
+#define hl_hsize(s) (1UL << ((s) + 3))
+#else
+#define hl_hsize(s) ((unsigned long)hlhprimes[s])
+#endif
+
+/* the value in slot i, as returned by hl_hget */
+#define hl_hval(h, i) ((h)->t ? (h)->t[i].v : (h)->e[i].v)
+
 /* hash table api */
 hlHashTable_t hl_hinit( hlState_t*  );
+hlHashTable_t hl_hinitkeyed( hlState_t* );
 void          hl_hset( hlHashTable_t*, unsigned char*, int, void* );
 int           hl_hget( hlHashTable_t*, unsigned char*, int );
 void          hl_hdel( hlHashTable_t*, unsigned char*, int );
+void          hl_hfree( hlHashTable_t* );
+void          hl_hreserve( hlHashTable_t*, unsigned long );
+unsigned long hl_hprobes( hlHashTable_t*, unsigned char*, int );
+#ifdef HL_HSTATS
+hlHashStats_t hl_hstats( hlHashTable_t* );
+void          hl_hstatsdump( hlState_t*, FILE* );
+#endif
+void          hl_hsetmany( hlHashTable_t*, unsigned char**, int*, void**, int );
+void          hl_hgetmany( hlHashTable_t*, unsigned char**, int*, int*, int );
+
+/* hash functions */
+unsigned      hl_hsax( unsigned char*, int );
+unsigned      hl_hsip( unsigned long*, unsigned char*, int );
+void          hl_hseed( hlState_t* );
+#ifdef HL_HPOW2
+unsigned      hl_hmix( unsigned char*, int );
+#endif
+
+/*
+ * Shared table, for globals read by many threads. One writer at a 
+ * time (callers serialize hl_hcset/hl_hcdel), readers never lock. 
+ * Readers validate against a sequence count that is odd while the 
+ * writer changes slots, and retry. A resize builds new arrays and 
+ * publishes them with one store, the old ones are freed once every 
+ * reader that could still hold them has left (epochs). 
+ * Keys are not copied and must outlive the table. 
+ * Needs GCC style __atomic builtins.
+ */
+#ifdef __GNUC__
+#define HL_HCREADERS 64
+
+typedef struct _hlHashArr_t {
+  int            s; /* size index */
+  unsigned long  n; /* slots */
+  unsigned char* m; /* control bytes, as in hlHashTable_t */
+  hlHashEl_t*    t;
+  unsigned long  e; /* epoch it was retired in */
+  struct _hlHashArr_t* next; /* retired list */
+} hlHashArr_t;
+
+typedef struct {
+  unsigned long e; /* epoch the reader entered in, 0 outside */
+  unsigned long u; /* slot taken */
+  char          pad[128 - 2 * sizeof(unsigned long)]; /* no false sharing */
+} hlHashReader_t;
+
+typedef struct {
+  hlHashArr_t*   a; /* current arrays */
+  unsigned long  seq; /* odd while the writer changes slots */
+  unsigned long  epoch;
+  unsigned       c; /* writer only from here */
+  unsigned       d;
+  hlHashArr_t*   old; /* retired arrays */
+  hlHashReader_t r[HL_HCREADERS];
+} hlHashShared_t;
+
+hlHashShared_t* hl_hcinit( void );
+int             hl_hcjoin( hlHashShared_t* );
+void            hl_hcleave( hlHashShared_t*, int );
+int             hl_hcget( hlHashShared_t*, int, unsigned char*, int, void** );
+void            hl_hcset( hlHashShared_t*, unsigned char*, int, void* );
+void            hl_hcdel( hlHashShared_t*, unsigned char*, int );
+void            hl_hcfree( hlHashShared_t* );
+#endif
+
+/*
+ * Arena
+ * Bump allocation from chained blocks, everything is released at once.
+ */
+
+#define HL_ABLOCK 65536 /* bytes per block, larger requests get their own */
+
+typedef struct _hlArenaBlock_t {
+  struct _hlArenaBlock_t* next;
+  unsigned long           n; /* usable bytes */
+  unsigned long           used;
+} hlArenaBlock_t;
+
+typedef struct {
+  hlArenaBlock_t* b; /* current block first */
+  unsigned long   bytes; /* handed out, for accounting */
+} hlArena_t;
+
+void* hl_aalloc( hlArena_t*, unsigned long );
+void  hl_afree( hlArena_t* );
+
+/*
+ * Ordered Map
+ * A skip list keyed by byte strings in memcmp order, shorter first on
+ * a tie. Each node is one arena allocation holding its links and a
+ * copy of the key. Deleted nodes are kept on free lists by size.
+ */
+
+#define HL_MMAXH  24 /* tallest tower, 4^24 keys */
+#define HL_MFREE  64 /* free lists, in 16 byte size classes */
+
+typedef struct _hlMapNode_t hlMapNode_t;
+
+struct _hlMapNode_t {
+  unsigned char* k; /* points into the node */
+  int            l;
+  int            h; /* height */
+  void*          v;
+  hlMapNode_t*   next[1];
+};
+
+typedef struct {
+  hlMapNode_t*  head; /* HL_MMAXH links, no key */
+  int           h; /* height in use */
+  unsigned long c; /* count */
+  unsigned long r; /* random state for tower heights */
+  hlArena_t     a;
+  hlMapNode_t*  free[HL_MFREE];
+  hlState_t*    state;
+} hlMap_t;
+
+/* keys in [lo, hi), a NULL bound is open */
+typedef struct {
+  hlMapNode_t*   n;
+  unsigned char* hi;
+  int            hl;
+} hlMapRange_t;
+
+hlMap_t      hl_minit( hlState_t* );
+void         hl_mset( hlMap_t*, unsigned char*, int, void* );
+hlMapNode_t* hl_mget( hlMap_t*, unsigned char*, int );
+void         hl_mdel( hlMap_t*, unsigned char*, int );
+hlMapNode_t* hl_mfloor( hlMap_t*, unsigned char*, int );
+hlMapNode_t* hl_mceil( hlMap_t*, unsigned char*, int );
+hlMapRange_t hl_mrange( hlMap_t*, unsigned char*, int, unsigned char*, int );
+hlMapNode_t* hl_mnext( hlMapRange_t* );
+void         hl_mfree( hlMap_t* );
+
+/* first node, then successors in key order */
+#define hl_mfirst(m) ((m)->head->next[0])
+#define hl_msucc(n)  ((n)->next[0])
+
+/*
+ * Shared ordered map, a lock-free skip list for indexes that several
+ * threads read and update. Links are swapped with CAS, a delete marks
+ * the node's links before unlinking it, and unlinked nodes are freed
+ * by epochs once no thread can still reach them. Every thread takes 
+ * a slot with hl_mcjoin, which also holds its tower height generator.
+ * Needs GCC style __atomic builtins.
+ */
+#ifdef __GNUC__
+#define HL_MCTHREADS 64
+#define HL_MCBATCH   64 /* retired nodes per reclaim attempt */
+
+typedef struct _hlMapCNode_t hlMapCNode_t;
+
+struct _hlMapCNode_t {
+  unsigned char* k; /* points into the node */
+  int            l;
+  int            h; /* height */
+  void*          v;
+  int            st; /* 1 when inserted, 2 when unlinked */
+  unsigned long  re; /* epoch it was retired in */
+  hlMapCNode_t*  r; /* retired list */
+  hlMapCNode_t*  next[1]; /* low bit marks a deleted node */
+};
+
+typedef struct {
+  unsigned long e; /* epoch the thread entered in, 0 outside */
+  unsigned long u; /* slot taken */
+  unsigned long rnd; /* tower heights */
+  hlMapCNode_t* r; /* retired, not yet freed */
+  unsigned long rc;
+  char          pad[128 - 5 * sizeof(unsigned long)];
+} hlMapThread_t;
+
+typedef struct {
+  hlMapCNode_t* head; /* HL_MMAXH links */
+  unsigned long epoch;
+  unsigned long seed;
+  hlMapThread_t t[HL_MCTHREADS];
+} hlMapShared_t;
+
+hlMapShared_t* hl_mcinit( hlState_t* );
+int            hl_mcjoin( hlMapShared_t* );
+void           hl_mcleave( hlMapShared_t*, int );
+int            hl_mcget( hlMapShared_t*, int, unsigned char*, int, void** );
+void           hl_mcset( hlMapShared_t*, int, unsigned char*, int, void* );
+int            hl_mcdel( hlMapShared_t*, int, unsigned char*, int );
+void           hl_mcscan( hlMapShared_t*, int, unsigned char*, int, unsigned char*, int, 
+                 void (*)( void*, unsigned char*, int, void* ), void* );
+void           hl_mcfree( hlMapShared_t* );
+#endif
 
 /*
  * Values and Types
@@ -73,7 +313,7 @@ typedef struct {
 
 typedef struct {
   /* maybe meta data */
-  hlHashTable_t h;
+  hlHashTable_t h; /* script supplied keys, create with hl_hinitkeyed */
 } hlObject_t;
 
 typedef struct {
@@ -91,6 +331,7 @@ struct _hlValue_t {
     hlBool_t    b;
     hlObject_t* o; 
     hlArray_t   a;
+    hlMap_t*    m;
   } v;
 };
 
@@ -101,10 +342,23 @@ struct _hlValue_t {
 struct _hlFunc_t {
   hlFunc_t*      env;
   hlState_t*     state;
-  hlHashTable_t  locals;
+  hlHashTable_t  locals; /* of the global function, globals by name */
   hlValue_t*     estack;
-  unsigned*      ins;
+  hlValue_t*     k; /* constants, see vpushval */
+  int            kc;
+  int            ks;
+  hlHashTable_t  kmap; /* type and bits to index in k */
+  hlArena_t      ka; /* the keys of kmap */
+  hlValue_t*     slots; /* locals by slot, see declare */
+  int            sc;
+  int*           vars; /* names of the locals in scope by slot, while compiling */
+  int            vc;
+  int            vs;
+  int            vb; /* the first var of the innermost block */
+  int            nest; /* blocks open */
+  unsigned*      ins; /* see ipush */
   int            ip;
+  int            is;
   int            ep;
   int            scan;
 };
@@ -123,35 +377,77 @@ reserved symbols: \ { } [ ] : ( ) ; , " ' -- :: .. . ->
 other reserved words: let if else return while fn true false nil for in break
 */
 
+/* a view of the source, names and strings carry their interned id */
 typedef struct {
   int type;
-  int  l;
+  int off; /* first byte in prog */
+  int l; /* bytes in prog */
   union {
     hlNum_t number;
-    unsigned char* data;
+    int     id;
   } value;
 } hlToken_t;
 
+/* 
+ * a whole source lexed up front by hl_lall, one array per token 
+ * field. lit holds the interned id of names and strings, the index
+ * in num of numbers and the value of booleans 
+ */
+typedef struct {
+  unsigned char* type;
+  int*           off;
+  int*           len;
+  int*           lit;
+  int            n; /* tokens, the last is the end */
+  int            s;
+  hlNum_t*       num;
+  int            nn;
+  int            ns;
+} hlTokens_t;
+
 /*
  * Compiler State
  */
 
 struct _hlState_t {
   int            error;
+  int            lquiet; /* lexer errors only set error */
   int            ptr;
   hlToken_t      ctok;
+  hlToken_t      ptok; /* the token before ctok */
+  hlTokens_t*    toks; /* the parser reads these if set, else lexes as it goes */
+  int            tp; /* next token in toks */
   unsigned char* prog;
+  unsigned char* pend; /* end of prog, NULL if prog ends at a 0 byte */
+
+  /* interned names and string literals, see hl_intern */
+  hlHashTable_t  names; /* bytes to id */
+  hlString_t**   strs; /* by id, 0 is the empty string */
+  int            sc;
+  int            ss;
+  hlArena_t      sa; /* the strings themselves */
 
   /* vm */
   hlFunc_t*      fs; /* current function state */
   hlFunc_t*      global; /* global state */
-  int            vp;
-  hlValue_t*     vstack;
+  unsigned long  seed[2]; /* hl_hsip key, see hl_hseed */
+#ifdef HL_HSTATS
+  hlHashStats_t  hstats; /* every table of the run */
+#endif
+#ifdef HL_VSTATS
+  unsigned long  vins; /* instructions run */
+#endif
 };
 
 /* temporary (eventually make static) */
 void hl_pstart( hlState_t* );
+int  hl_lnext( hlState_t* ); /* lex the next token into s->ctok, 0 at the end, -1 on errors */
+int  hl_lsimd( int ); /* bytes the lexer scans at once, up to w if w >= 0 */
+int  hl_lall( hlState_t*, hlTokens_t* );
+int  hl_lpar( hlState_t*, hlTokens_t*, int ); /* hl_lall on up to n threads */
+void hl_tfree( hlTokens_t* );
 
 void hl_init( hlState_t* );
+int  hl_intern( hlState_t*, unsigned char*, int );
 void hl_vrun( hlState_t* );
 #endif
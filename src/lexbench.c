@@ -0,0 +1,261 @@
+/*
+ * Lexer benchmark
+ *
+ * Generates a script of about -n MB from a fixed seed, with every
+ * symbol and keyword, names, numbers, strings and both comment kinds,
+ * then lexes it with hl_lnext and prints the best MB/s of a few passes,
+ * and again into a token array with hl_lall. The token count and a
+ * checksum of the token types let lexer changes be checked against
+ * each other. With -f it lexes a file instead, -w
+ * limits the bytes scanned at once (1, 16 or 32) to compare scanners.
+ * Last it lexes with hl_lpar on 1, 2, 4 .. -j threads, checking the
+ * arrays match hl_lall's.
+ *
+ * usage: lexbench [-n MB] [-f file] [-w width] [-j threads]
+ */
+
+#define _POSIX_C_SOURCE 199506L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "holly.h"
+
+#define BENCH_PASSES 3
+
+static unsigned long nsnow( void ){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (unsigned long)t.tv_sec * 1000000000UL + t.tv_nsec;
+}
+
+static unsigned long rs = 0x9e3779b97f4a7c15UL;
+
+static unsigned long rnd( void ){
+  rs ^= rs << 13;
+  rs ^= rs >> 7;
+  rs ^= rs << 17;
+  return rs;
+}
+
+/*
+ * Corpus
+ */
+
+typedef struct {
+  char* b;
+  long  n;
+  long  s;
+} benchBuf_t;
+
+static void put( benchBuf_t* b, const char* s ){
+  long l = strlen(s);
+  if( b->n + l + 1 > b->s ){
+    b->s = 2 * (b->n + l + 1);
+    b->b = realloc(b->b, b->s);
+  }
+  memcpy(b->b + b->n, s, l + 1);
+  b->n += l;
+}
+
+static const char* names[] = {
+  "x", "i", "count", "total_size", "player", "velocity", "buf2", "Matrix",
+  "a_very_long_identifier_name", "lets", "iff", "format", "Node", "k"
+};
+
+static const char* ops[] = {
+  "+", "-", "*", "/", "%", "^", "|", "&", "<<", ">>", "==", "<", ">",
+  "<=", ">=", "and", "or"
+};
+
+static const char* assigns[] = {
+  "=", "|=", "-=", "+=", "*=", "^=", "/=", "%=", ">>=", "<<=", "&="
+};
+
+#define pick(a) (a[rnd() % (sizeof(a) / sizeof(a[0]))])
+
+static void value( benchBuf_t* b ){
+  char t[64];
+  switch( rnd() % 6 ){
+    case 0: sprintf(t, "%lu", rnd() % 100000); break;
+    case 1: sprintf(t, "%lu.%lu", rnd() % 1000, rnd() % 1000); break;
+    case 2: sprintf(t, "\"str %lu with \\\"quotes\\\" in\"", rnd() % 100); break;
+    case 3: sprintf(t, "'%s'", pick(names)); break;
+    case 4: sprintf(t, "%s", rnd() & 1 ? "true" : "nil"); break;
+    default: sprintf(t, "%s", pick(names)); break;
+  }
+  put(b, t);
+}
+
+static void expr( benchBuf_t* b ){
+  int i, n = 1 + rnd() % 4;
+  for( i = 0; i < n; i++ ){
+    if( i ){
+      put(b, " ");
+      put(b, pick(ops));
+      put(b, " ");
+    }
+    if( !(rnd() % 8) ) put(b, "!");
+    value(b);
+    if( !(rnd() % 6) ){
+      put(b, "[");
+      value(b);
+      put(b, "]");
+    }
+  }
+}
+
+static void statement( benchBuf_t* b, int d ){
+  int i;
+  for( i = 0; i < d; i++ ) put(b, "  ");
+  switch( rnd() % (d < 3 ? 10 : 7) ){
+    case 0: put(b, "let "); put(b, pick(names)); put(b, " = "); expr(b); break;
+    case 1: put(b, pick(names)); put(b, " "); put(b, pick(assigns)); put(b, " "); expr(b); break;
+    case 2: put(b, "log "); expr(b); break;
+    case 3: put(b, "-- a line comment, with symbols += and \"quotes\""); break;
+    case 4: put(b, "/- a block comment\n   over two lines -/"); break;
+    case 5: put(b, pick(names)); put(b, ":"); put(b, pick(names)); put(b, ".");
+            put(b, pick(names)); put(b, "(1, 2)"); break;
+    case 6: put(b, "return "); expr(b); break;
+    case 7: put(b, "if "); expr(b); put(b, " {\n"); goto body;
+    case 8: put(b, "while "); expr(b); put(b, " {\n"); goto body;
+    default: put(b, "fn "); put(b, pick(names)); put(b, " a, b -> {\n"); goto body;
+  }
+  put(b, rnd() % 4 ? "\n" : ";\n");
+  return;
+body:
+  for( i = rnd() % 5; i >= 0; i-- ) statement(b, d + 1);
+  for( i = 0; i < d; i++ ) put(b, "  ");
+  put(b, rnd() % 3 ? "}\n" : "} else { break }\n");
+}
+
+static unsigned char* corpus( long mb, long* n ){
+  benchBuf_t b;
+  b.b = NULL;
+  b.n = b.s = 0;
+  while( b.n < mb << 20 ) statement(&b, 0);
+  *n = b.n;
+  return (unsigned char *)b.b;
+}
+
+static unsigned char* readfile( const char* f, long* n ){
+  unsigned char* b;
+  FILE* fp = fopen(f, "rb");
+  if( !fp ) return NULL;
+  fseek(fp, 0, SEEK_END);
+  *n = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  b = malloc(*n + 1);
+  if( fread(b, 1, *n, fp) != (size_t)*n ){
+    fclose(fp);
+    free(b);
+    return NULL;
+  }
+  fclose(fp);
+  b[*n] = 0;
+  return b;
+}
+
+/* 1 if the arrays hold the same tokens */
+static int same( hlTokens_t* a, hlTokens_t* b ){
+  int i;
+  if( a->n != b->n || a->nn != b->nn ) return 0;
+  for( i = 0; i < a->n; i++ ){
+    if( 
+      a->type[i] != b->type[i] || a->off[i] != b->off[i] || 
+      a->len[i] != b->len[i] || a->lit[i] != b->lit[i] 
+    ) return 0;
+  }
+  return !a->nn || !memcmp(a->num, b->num, a->nn * sizeof(hlNum_t));
+}
+
+static int usage( const char* p ){
+  fprintf(stderr, "usage: %s [-n MB] [-f file] [-w width] [-j threads]\n", p);
+  return 1;
+}
+
+int main( int argc, char** argv ){
+  unsigned long ns, best = 0, sum = 0, toks = 0, abest = 0, asum;
+  unsigned char* p;
+  const char* f = NULL;
+  long mb = 16, n;
+  int i, j, r, w = 32, jmax = 8;
+  hlTokens_t t, u;
+  hlState_t s;
+  for( i = 1; i < argc; i++ ){
+    if( !strcmp(argv[i], "-n") && i + 1 < argc ) mb = atol(argv[++i]);
+    else if( !strcmp(argv[i], "-f") && i + 1 < argc ) f = argv[++i];
+    else if( !strcmp(argv[i], "-w") && i + 1 < argc ) w = atoi(argv[++i]);
+    else if( !strcmp(argv[i], "-j") && i + 1 < argc ) jmax = atoi(argv[++i]);
+    else return usage(argv[0]);
+  }
+  if( f ){
+    if( !(p = readfile(f, &n)) ){
+      fprintf(stderr, "can't read %s\n", f);
+      return 1;
+    }
+  } else p = corpus(mb > 0 ? mb : 1, &n);
+  hl_init(&s);
+  s.prog = p;
+  s.pend = p + n;
+  w = hl_lsimd(w);
+  for( i = 0; i < BENCH_PASSES; i++ ){
+    s.ptr = 0;
+    s.error = 0;
+    sum = toks = 0;
+    ns = nsnow();
+    while( (r = hl_lnext(&s)) > 0 ){
+      sum = sum * 31 + s.ctok.type;
+      toks++;
+    }
+    ns = nsnow() - ns;
+    if( r < 0 ){
+      fprintf(stderr, "lex error at byte %d\n", s.ptr);
+      return 1;
+    }
+    if( !best || ns < best ) best = ns;
+  }
+  for( i = 0; i < BENCH_PASSES; i++ ){
+    s.error = 0;
+    ns = nsnow();
+    r = hl_lall(&s, &t);
+    ns = nsnow() - ns;
+    if( r < 0 ){
+      fprintf(stderr, "lex error at byte %d\n", s.ptr);
+      return 1;
+    }
+    if( !abest || ns < abest ) abest = ns;
+    for( asum = r = 0; r < t.n - 1; r++ ) asum = asum * 31 + t.type[r];
+    if( asum != sum ) printf("  ! token array differs\n");
+    if( i < BENCH_PASSES - 1 ) hl_tfree(&t);
+  }
+  printf("%s: %.1f MB, %lu tokens, checksum %08lx\n", f ? f : "generated",
+    n / 1048576.0, toks, sum & 0xffffffffUL);
+  printf("lex %8.1f MB/s %8.1f Mtokens/s (best of %d, scanning %d bytes at once)\n",
+    n / 1048576.0 / (best / 1e9), toks / 1e6 / (best / 1e9), BENCH_PASSES, w);
+  printf("lex %8.1f MB/s %8.1f Mtokens/s into a token array\n",
+    n / 1048576.0 / (abest / 1e9), toks / 1e6 / (abest / 1e9));
+  for( j = 1; j <= jmax; j *= 2 ){
+    for( best = 0, i = 0; i < BENCH_PASSES; i++ ){
+      s.error = 0;
+      ns = nsnow();
+      r = hl_lpar(&s, &u, j);
+      ns = nsnow() - ns;
+      if( r < 0 ){
+        fprintf(stderr, "lex error at byte %d\n", s.ptr);
+        return 1;
+      }
+      if( !best || ns < best ) best = ns;
+      if( !same(&t, &u) ) printf("  ! %d threads lexed different tokens\n", j);
+      hl_tfree(&u);
+    }
+    printf("lex %8.1f MB/s %8.1f Mtokens/s on %d thread%s, %.2fx\n",
+      n / 1048576.0 / (best / 1e9), toks / 1e6 / (best / 1e9), j, j > 1 ? "s" : "", 
+      (double)abest / best);
+  }
+  hl_tfree(&t);
+  free(p);
+  return 0;
+}
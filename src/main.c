@@ -1,7 +1,22 @@
+/* sources are mapped where there is mmap, read in elsewhere */
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define HL_MMAP
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+
+#ifdef HL_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "holly.h"
  
@@ -41,96 +56,104 @@ void primelist( void ){
   printf("};\n\n");
 }
 
-#include <time.h>
-
-/* get word from file */
-unsigned char* getWord (FILE* f) {
-  unsigned char* buf = NULL;
-  int c = 0, i = 0, bufsize = 10;
-  buf = malloc(bufsize + 1);
-  memset(buf, 0, bufsize + 1);
-  while ((c = fgetc(f)) != '\n') {
-    if (c == EOF) return NULL;
-    if (i == bufsize)
-      buf = realloc(buf, (bufsize += 10) + 1);
-    buf[i++] = (unsigned char)c;
-  }
-  buf[i] = 0;
-  return buf;
-} 
-
-void loadWords (hlHashTable_t* root) {
-  FILE* in = fopen("../cuckoo/words.txt", "r");
-  unsigned char* word = NULL;
-  /*int i = 0, total = 0;*/
-  while ((word = getWord(in))) {
-    int l = strlen((char *)word);
-    hl_hset(root, word, l, (void*)word);
-  }/*
-  fclose(in);
-  
-  printf("inserted %d elements\n", root->c);
-  
-  in = fopen("../cuckoo/words.txt", "r");
-  while ((word = getWord(in))) {
-    int l = strlen((char *)word);
-    i = hl_hget(root, word, l);
-    if( i > -1 ){
-      total++;
-    }
-  }
-  printf("retrieved %d elements\n", total);
-  
-  fclose(in);
-  
-  in = fopen("../cuckoo/words.txt", "r");
-  while ((word = getWord(in))) {
-    int l = strlen((char *)word);
-    hl_hdel(root, word, l);
-  }
-  
-  fclose(in);
-  puts("deleted");
-  printf("remaining elements: %d\n", root->c);*/
-}
-
-void hashtest( void ){
-  hlState_t state;
-  double end, start;
-  hlHashTable_t table = hl_hinit(&state);
-
-  start = (float)clock()/CLOCKS_PER_SEC; 
-  loadWords(&table);
-  end = (float)clock()/CLOCKS_PER_SEC;
-    
-  printf("Inserted, retrieved, and deleted %d objects in %fs - Table size: %d\n", table.c, end - start, hlhprimes[table.s]);
-}
-
-unsigned char* readfile( const char* n ){
+/* 
+ * the bytes of file n and their count in l, not 0 terminated. m is
+ * set if they are mapped, which leaves them shared in the page cache 
+ */
+unsigned char* readfile( const char* n, long* l, int* m ){
   unsigned char *buf;
-  long fsize;
-  FILE *f = fopen(n, "rb");
+  FILE *f;
+#ifdef HL_MMAP
+  struct stat st;
+  int fd = open(n, O_RDONLY);
+  if( fd < 0 ) return NULL;
+  if( !fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0 ){
+    buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if( buf == MAP_FAILED ) return NULL;
+    posix_madvise(buf, st.st_size, POSIX_MADV_SEQUENTIAL);
+    *l = st.st_size;
+    *m = 1;
+    return buf;
+  }
+  close(fd); /* empty or not a regular file */
+#endif
+  *m = 0;
+  if( !(f = fopen(n, "rb")) ) return NULL;
   fseek(f, 0, SEEK_END);
-  fsize = ftell(f);
+  *l = ftell(f);
   fseek(f, 0, SEEK_SET);
-  buf = malloc(fsize + 1);
-  if( !fread(buf, fsize, 1, f) ){
+  if( *l < 0 || !(buf = malloc(*l + 1)) ){
+    fclose(f);
+    return NULL;
+  }
+  if( *l && !fread(buf, *l, 1, f) ){
     fclose(f);
+    free(buf);
     return NULL;
   }
   fclose(f);
-  buf[fsize] = 0;
   return buf;
 }
 
+void freefile( unsigned char* p, long l, int m ){
+#ifdef HL_MMAP
+  if( m ){
+    munmap(p, l);
+    return;
+  }
+#endif
+  (void)l;
+  (void)m;
+  free(p);
+}
+
+#define ms(c) ((double)(c) * 1000 / CLOCKS_PER_SEC)
+
+/* 
+ * holly [-t] [-j n] file, -t prints the time spent lexing, parsing and 
+ * running, -j lexes on n threads 
+ */
 int main( int argc, char** argv ) {
-  if( argc > 1 ){
-    unsigned char* p = readfile(argv[1]);
+  int a = 1, t = 0, j = 1;
+  for( ; a + 1 < argc && argv[a][0] == '-'; a++ ){
+    if( !strcmp(argv[a], "-t") ) t = 1;
+    else if( !strcmp(argv[a], "-j") && a + 2 < argc ) j = atoi(argv[++a]);
+    else break;
+  }
+  if( argc > a ){
+    long l;
+    int m;
+    unsigned char* p = readfile(argv[a], &l, &m);
+    clock_t c[4];
+    hlTokens_t toks;
     hlState_t s;
+    if( !p ){
+      fprintf(stderr, "can't read %s\n", argv[a]);
+      return 1;
+    }
     hl_init(&s);
     s.prog = p;
+    s.pend = p + l;
+    c[0] = clock();
+    if( hl_lpar(&s, &toks, j) >= 0 ) s.toks = &toks;
+    c[1] = clock();
     hl_pstart(&s);
+    c[2] = clock();
     hl_vrun(&s);
+    c[3] = clock();
+    if( t ){
+      fprintf(stderr, "lex %.2fms, %d tokens\n", ms(c[1] - c[0]), toks.n);
+      fprintf(stderr, "parse %.2fms\nrun %.2fms\n", ms(c[2] - c[1]), ms(c[3] - c[2]));
+    }
+#ifdef HL_HSTATS
+    hl_hstatsdump(&s, stderr);
+#endif
+#ifdef HL_VSTATS
+    fprintf(stderr, "%lu instructions run\n", s.vins);
+#endif
+    hl_tfree(&toks);
+    freefile(p, l, m);
   }
   return 0;
 }
@@ -0,0 +1,52 @@
+/*
+ * Wide operand check
+ *
+ * Writes a script that compiles to more than 100k instructions, with
+ * more constants, locals and jump distance than a narrow operand can
+ * hold, and prints the output holly should log for it. A while loop
+ * runs an if/else whose branches add WIDE_CONSTS distinct constants
+ * and subtract WIDE_SLOTS locals in turn, so constant indices, slots,
+ * forward jumps over each branch and the backward loop jump all need
+ * OP_EXTARG prefixes once HL_ARGBITS is small. `make test-wide` runs
+ * it; run it again with FLAGS=-DHL_ARGBITS=8 to cover the prefixes.
+ *
+ * usage: widegen script > expected
+ */
+
+#include <stdio.h>
+
+#define WIDE_SLOTS  300   /* locals, past an 8 bit slot */
+#define WIDE_CONSTS 70000 /* constants, past a 16 bit index */
+#define WIDE_SUBS   30000 /* subtractions in the else branch */
+#define WIDE_BASE   1000  /* first constant, past the slot values */
+
+int main( int argc, char** argv ){
+  FILE* f;
+  double acc = 0;
+  long i;
+  if( argc != 2 ){
+    fprintf(stderr, "usage: widegen script > expected\n");
+    return 1;
+  }
+  if( !(f = fopen(argv[1], "w")) ){
+    fprintf(stderr, "can't write %s\n", argv[1]);
+    return 1;
+  }
+  fprintf(f, "if true {\n");
+  for( i = 0; i < WIDE_SLOTS; i++ )
+    fprintf(f, "  let v%ld = %ld\n", i, i);
+  fprintf(f, "  let acc = 0\n  let i = 0\n  while i < 2 {\n    if i == 0 {\n");
+  for( i = 0; i < WIDE_CONSTS; i++ ){
+    fprintf(f, "      acc = acc + %ld\n", WIDE_BASE + i);
+    acc += WIDE_BASE + i;
+  }
+  fprintf(f, "    } else {\n");
+  for( i = 0; i < WIDE_SUBS; i++ ){
+    fprintf(f, "      acc = acc - v%ld\n", i % WIDE_SLOTS);
+    acc -= i % WIDE_SLOTS;
+  }
+  fprintf(f, "    }\n    i = i + 1\n  }\n  log acc\n}\n");
+  fclose(f);
+  printf("%f\n", acc);
+  return 0;
+}